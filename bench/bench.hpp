@@ -0,0 +1,64 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "statistics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <string_view>
+
+// minimal harness shared by the benchmarks: an operation is run over a set of
+// inputs for a few untimed warm-up repetitions, then timed over the others
+namespace Bench {
+
+struct Options
+{
+  int warm_up{3};
+  int repetitions{15};
+  // only the benchmarks whose name contains it are run
+  std::string_view filter{};
+};
+
+// times op(i) for i in [0, n_ops) and prints the mean, standard deviation and
+// minimum of the ns per operation over the repetitions. The values returned
+// by op are summed and printed, so that the calls cannot be optimised away.
+template<typename F>
+void run(Options const& options, std::string_view name, std::size_t n_ops,
+         F&& op)
+{
+  if (name.find(options.filter) == std::string_view::npos) {
+    return;
+  }
+
+  double checksum{0.};
+  auto const repetition = [&] {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i{0}; i != n_ops; ++i) {
+      checksum += static_cast<double>(op(i));
+    }
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(n_ops);
+  };
+
+  for (int r{0}; r != options.warm_up; ++r) {
+    repetition();
+  }
+  Sample sample;
+  double best{std::numeric_limits<double>::infinity()};
+  for (int r{0}; r != options.repetitions; ++r) {
+    double const ns{repetition()};
+    sample.add(ns);
+    best = std::min(best, ns);
+  }
+  Statistics const s{sample.statistics()};
+  std::printf("%-60.*s %9.1f ns/op +- %7.1f  min %9.1f  (%g)\n",
+              static_cast<int>(name.size()), name.data(), s.mean, s.std_dev,
+              best, checksum);
+}
+
+} // namespace Bench
+
+#endif
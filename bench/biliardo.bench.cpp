@@ -0,0 +1,172 @@
+// ns per operation of the physics kernels, to be compared before and after a
+// change: run in Release, optionally with a filter on the names, as in
+//   biliardo_bench eq_solve
+#include "bench.hpp"
+#include "kinematics.hpp"
+#include "mathematics.hpp"
+#include "random.hpp"
+#include "statistics.hpp"
+#include <algorithm>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t N_INPUTS{1 << 14};
+constexpr std::size_t BLOCK{1024};
+
+struct Scenario
+{
+  char const* name;
+  Barrier up;
+  Barrier down;
+  double y0;
+  double theta0;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  Bench::Options options;
+  if (argc > 1) {
+    options.filter = argv[1];
+  }
+
+  double const l{4.};
+  std::default_random_engine eng{1};
+  std::uniform_real_distribution x_dist{0., l};
+  std::uniform_real_distribution q_dist{-1.5, 1.5};
+  std::uniform_real_distribution m_dist{-1., 1.};
+  std::uniform_real_distribution theta_dist{-1.5, 1.5};
+  std::normal_distribution normal_dist{0., 1.};
+  std::vector<double> xs;
+  std::vector<FixedPol<1>> lines;
+  std::vector<Pol> pol_lines;
+  std::vector<Trajectory> trajectories;
+  std::vector<double> normals;
+  for (std::size_t i{0}; i != N_INPUTS; ++i) {
+    xs.push_back(x_dist(eng));
+    double const q{q_dist(eng)};
+    double const m{m_dist(eng)};
+    lines.emplace_back(q, m);
+    pol_lines.push_back({q, m});
+    trajectories.emplace_back(Vec2{0., q_dist(eng) / 2.}, theta_dist(eng));
+    normals.push_back(normal_dist(eng));
+  }
+
+  Pol const linear{1.5, -0.2};
+  Pol const quadratic{1.5, 0.1, -0.05};
+  Pol const cubic{1.5, -0.3, 0.05, 0.01};
+  Pol const quartic{1.5, 0.1, -0.2, 0.02, 0.001};
+  Pol const sextic{1.5, 0., -0.1, 0., 0., 0., 0.0002};
+  Pol const octic{1.5, 0., -0.1, 0., 0., 0., 0., 0., 0.00001};
+
+  for (auto [name, pol] : {std::pair{"degree 2", &quadratic},
+                           std::pair{"degree 4", &quartic},
+                           std::pair{"degree 8", &octic}}) {
+    Bench::run(options, std::string{"Pol::operator(), "} + name, N_INPUTS,
+               [&](std::size_t i) { return (*pol)(xs[i]); });
+    Bench::run(options, std::string{"Pol::der, "} + name, N_INPUTS,
+               [&](std::size_t i) { return pol->der(xs[i]); });
+  }
+
+  FixedPol<2> const fixed_quadratic{quadratic};
+  Bench::run(options, "eq_solve, degree 2, FixedPol", N_INPUTS,
+             [&](std::size_t i) {
+               return eq_solve(lines[i], fixed_quadratic, 0., l).size();
+             });
+  for (auto [name, pol] : {std::pair{"degree 2", &quadratic},
+                           std::pair{"degree 3, closed form", &cubic},
+                           std::pair{"degree 4, closed form", &quartic},
+                           std::pair{"degree 6, Sturm", &sextic},
+                           std::pair{"degree 8, Sturm", &octic}}) {
+    Bench::run(options, std::string{"eq_solve, "} + name, N_INPUTS,
+               [&](std::size_t i) {
+                 return eq_solve(pol_lines[i], *pol, 0., l).size();
+               });
+  }
+
+  for (auto [name, pol] : {std::pair{"degree 1", &linear},
+                           std::pair{"degree 2", &quadratic},
+                           std::pair{"degree 4", &quartic},
+                           std::pair{"degree 8", &octic}}) {
+    Barrier const barrier{*pol, l};
+    Bench::run(options, std::string{"intersect, "} + name, N_INPUTS,
+               [&](std::size_t i) {
+                 return intersect(trajectories[i], &barrier).size();
+               });
+  }
+
+  // the number of bounces is measured, so that the name shows if a change
+  // of the engine moved a scenario
+  Scenario const scenarios[]{
+      {"straight exit", {l, 1.5, 0.7}, {l, -1.5, -0.7}, 0., 0.1},
+      {"one bounce", {l, 1.5, 0.7}, {l, -1.5, -0.7}, 0., 0.3},
+      {"two bounces", {l, 1.5, 0.7}, {l, -1.5, -0.7}, 0., 0.45},
+      {"back to the entrance", {l, 1.5, 0.7}, {l, -1.5, -0.7}, 0., 0.6},
+      {"parallel walls", {10., 1., 1.}, {10., -1., -1.}, 0., 1.2},
+      {"MAX_ITERATIONS", {10., 1., 1.}, {10., -1., -1.}, 0., 1.4},
+      {"wedge", {l, 1.5, 0.1}, {l, -1.5, -0.1}, 0.2, 0.3},
+      {"degree 4", {quartic, l}, {-quartic, l}, 0.2, 0.6}};
+  for (Scenario const& s : scenarios) {
+    std::vector<Vec2> bounces;
+    Result const res{simulate_single_particle(
+        s.up, s.down, Trajectory{{0., s.y0}, s.theta0}, &bounces)};
+    // the starting point is recorded too, and the exit point if the particle
+    // exited; stopped at MAX_ITERATIONS, the last bounce is not recorded
+    bool const exited{res.get_x() == 0. || res.get_x() == s.up.max()};
+    std::size_t const n_bounces{exited ? bounces.size() - 2 : bounces.size()};
+    std::string const name{std::string{"simulate_single_particle, "} + s.name
+                           + " (" + std::to_string(n_bounces) + " bounces)"};
+    Bench::run(options, name, N_INPUTS, [&](std::size_t) {
+      return simulate_single_particle(s.up, s.down,
+                                      Trajectory{{0., s.y0}, s.theta0})
+          .get_y();
+    });
+  }
+
+  Bench::run(options, "Sample::add", N_INPUTS, [&](std::size_t i) {
+    static Sample sample;
+    sample.add(normals[i]);
+    return sample.size();
+  });
+  Bench::run(options, "Sample::add(span), per block of 1024", N_INPUTS / BLOCK,
+             [&](std::size_t i) {
+               static Sample sample;
+               sample.add(std::span{normals}.subspan(i * BLOCK, BLOCK));
+               return sample.size();
+             });
+  Sample sample;
+  sample.add(normals);
+  Bench::run(options, "Sample::statistics", N_INPUTS,
+             [&](std::size_t) { return sample.statistics().kurtosis; });
+
+  std::vector<double> uniforms(N_INPUTS);
+  fill_uniform(Philox{1}, 0, 0, uniforms);
+  std::vector<double> block(BLOCK);
+  Bench::run(options, "inverse_normal_cdf", N_INPUTS,
+             [&](std::size_t i) { return inverse_normal_cdf(uniforms[i]); });
+  Bench::run(options, "inverse_normal_cdf(span), per block of 1024",
+             N_INPUTS / BLOCK, [&](std::size_t i) {
+               std::copy_n(uniforms.begin()
+                               + static_cast<std::ptrdiff_t>(i * BLOCK),
+                           BLOCK, block.begin());
+               inverse_normal_cdf(block);
+               return block[0];
+             });
+  Bench::run(options, "fill_normal, per block of 1024", N_INPUTS / BLOCK,
+             [&](std::size_t i) {
+               fill_normal(Philox{1}, 0, i * BLOCK, 0., 1., block);
+               return block[0];
+             });
+  TruncatedNormal const truncated{0.3, 2., -1., 1.};
+  Bench::run(options, "fill_truncated_normal, per block of 1024",
+             N_INPUTS / BLOCK, [&](std::size_t i) {
+               fill_truncated_normal(Philox{1}, 0, i * BLOCK, truncated, block);
+               return block[0];
+             });
+}
@@ -0,0 +1,78 @@
+// compares CsvWriter with the std::ofstream output it replaced in
+// multiple_particle_sim_csv, on the same exits
+#include "output.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t N_EXITS{1 << 22};
+constexpr std::size_t CHUNK{1 << 14};
+
+template<typename F>
+void run(char const* name, std::string const& path, F&& write)
+{
+  auto start = std::chrono::steady_clock::now();
+  write();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double const size{static_cast<double>(std::filesystem::file_size(path))};
+  std::printf("%-28s %8.1f ns/line %8.1f MB/s\n", name,
+              elapsed.count() * 1e9 / N_EXITS, size / elapsed.count() * 1e-6);
+}
+
+} // namespace
+
+int main()
+{
+  std::default_random_engine eng{1};
+  std::normal_distribution y_dist{0., 0.5};
+  std::normal_distribution theta_dist{0., 0.4};
+  std::vector<Exit> exits(N_EXITS);
+  for (auto& e : exits) {
+    e = {y_dist(eng), theta_dist(eng)};
+  }
+  std::string const path{
+      (std::filesystem::temp_directory_path() / "biliardo_csv.bench.csv")
+          .string()};
+
+  // the loop of multiple_particle_sim_csv before CsvWriter
+  run("std::ofstream, precision 6", path, [&] {
+    std::ofstream file{path};
+    for (std::size_t i{0}; i < N_EXITS; i += CHUNK) {
+      for (std::size_t j{i}; j != i + CHUNK; ++j) {
+        file << exits[j].y << ", " << exits[j].theta << '\n';
+      }
+    }
+  });
+  run("std::ofstream, precision 17", path, [&] {
+    std::ofstream file{path};
+    file.precision(17);
+    for (std::size_t i{0}; i < N_EXITS; i += CHUNK) {
+      for (std::size_t j{i}; j != i + CHUNK; ++j) {
+        file << exits[j].y << ", " << exits[j].theta << '\n';
+      }
+    }
+  });
+  run("CsvWriter, precision 6", path, [&] {
+    CsvWriter writer{path, ", ", 6};
+    for (std::size_t i{0}; i < N_EXITS; i += CHUNK) {
+      writer.write(std::span{exits}.subspan(i, CHUNK));
+    }
+    writer.close();
+  });
+  run("CsvWriter, shortest", path, [&] {
+    CsvWriter writer{path};
+    for (std::size_t i{0}; i < N_EXITS; i += CHUNK) {
+      writer.write(std::span{exits}.subspan(i, CHUNK));
+    }
+    writer.close();
+  });
+
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,158 @@
+// performance regression gate: runs fixed Monte Carlo workloads on one thread
+// and compares their throughput and heap allocations with a baseline file,
+// one line per workload, e.g.
+//   workload=linear particles_per_second=1e7 allocations_per_particle=0.001
+// Without arguments the measured lines are printed, to write a new baseline;
+// with a baseline file the exit code is 1 if a workload is slower than
+// (1 - tolerance) times its baseline, or allocates more than
+// (1 + allocation_slack) times its baseline per particle.
+#include "job.hpp"
+#include "montecarlo.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<std::uint64_t> n_allocations{0};
+
+constexpr int REPETITIONS{5};
+constexpr std::uint64_t SEED{42};
+
+struct Workload
+{
+  char const* name;
+  Barrier up;
+  Barrier down;
+  std::size_t n;
+};
+
+struct Measure
+{
+  double particles_per_second;
+  double allocations_per_particle;
+  std::size_t n_exited;
+};
+
+// best of REPETITIONS runs, so that the throughput is not lowered by the
+// noise of the machine
+Measure measure(Workload const& w, ThreadPool& pool)
+{
+  Beam const beam{0., 0.5, 0., 0.4};
+  Measure res{0., 0., 0};
+  for (int r{0}; r != REPETITIONS; ++r) {
+    std::uint64_t const allocations{n_allocations.load()};
+    auto start = std::chrono::steady_clock::now();
+    MonteCarloResult const mc{
+        simulate_n_particles(w.up, w.down, beam, w.n, SEED, pool)};
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    double const n{static_cast<double>(w.n)};
+    res.particles_per_second =
+        std::max(res.particles_per_second, n / elapsed.count());
+    res.allocations_per_particle =
+        static_cast<double>(n_allocations.load() - allocations) / n;
+    res.n_exited = static_cast<std::size_t>(mc.y.size());
+  }
+  return res;
+}
+
+} // namespace
+
+// every allocation of the program is counted, including the ones of the
+// worker threads
+void* operator new(std::size_t size)
+{
+  n_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+int main(int argc, char* argv[])
+{
+  try {
+    if (argc > 2) {
+      throw std::invalid_argument{"usage: perf_gate.b [<baseline file>]"};
+    }
+
+    Pol const quartic{1.5, 0.1, -0.2, 0.02, 0.001};
+    // linear barriers go through the Unfolding engine, the others through
+    // simulate_single_particle
+    Workload const workloads[]{
+        {"linear", {4., 1.5, 0.7}, {4., -1.5, -0.7}, std::size_t{1} << 20},
+        {"degree_4", {quartic, 4.}, {-quartic, 4.}, std::size_t{1} << 16}};
+    ThreadPool pool{1};
+
+    if (argc == 1) {
+      for (Workload const& w : workloads) {
+        Measure const m{measure(w, pool)};
+        std::printf("workload=%s particles_per_second=%.4g "
+                    "allocations_per_particle=%.4g\n",
+                    w.name, m.particles_per_second,
+                    m.allocations_per_particle);
+      }
+      return EXIT_SUCCESS;
+    }
+
+    std::ifstream file{argv[1]};
+    if (!file) {
+      throw std::runtime_error{std::string{"Cannot open "} + argv[1]};
+    }
+    std::vector<Job> const baselines{read_jobs(file)};
+
+    bool passed{true};
+    for (Workload const& w : workloads) {
+      auto const baseline = std::find_if(
+          baselines.begin(), baselines.end(), [&](Job const& job) {
+            return job.get<std::string>("workload") == w.name;
+          });
+      if (baseline == baselines.end()) {
+        throw std::runtime_error{std::string{"No baseline for workload "}
+                                 + w.name};
+      }
+      double const pps{baseline->get<double>("particles_per_second")};
+      double const apps{baseline->get<double>("allocations_per_particle")};
+      double const tolerance{baseline->get<double>("tolerance", 0.25)};
+      double const slack{baseline->get<double>("allocation_slack", 0.25)};
+      baseline->check_unused();
+
+      Measure const m{measure(w, pool)};
+      bool const fast{m.particles_per_second >= (1. - tolerance) * pps};
+      bool const lean{m.allocations_per_particle <= (1. + slack) * apps};
+      std::printf("%-10s %12.4g particles/s (baseline %.4g) %s, %10.4g "
+                  "allocations/particle (baseline %.4g) %s, %zu exited\n",
+                  w.name, m.particles_per_second, pps, fast ? "ok" : "SLOWER",
+                  m.allocations_per_particle, apps, lean ? "ok" : "MORE",
+                  m.n_exited);
+      passed = passed && fast && lean;
+    }
+    if (!passed) {
+      std::printf("performance regression against %s\n", argv[1]);
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (std::exception const& e) {
+    std::fprintf(stderr, "Error: %s\n", e.what());
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,205 @@
+#include "batch.hpp"
+#include "batch_kernel.hpp"
+#include "globals.hpp"
+#include "kinematics.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// the scalar kernel: gcc vectorises it for the baseline instruction set.
+// Masks are doubles (0 or 1) combined arithmetically: with bool masks gcc
+// turns the selects back into branches and gives up
+struct Scalar
+{
+  using V = double;
+  using M = double;
+  static constexpr std::size_t width{1};
+
+  static V load(double const* p)
+  {
+    return *p;
+  }
+  static void store(double* p, V v)
+  {
+    *p = v;
+  }
+  static V set1(double x)
+  {
+    return x;
+  }
+  static V add(V a, V b)
+  {
+    return a + b;
+  }
+  static V sub(V a, V b)
+  {
+    return a - b;
+  }
+  static V mul(V a, V b)
+  {
+    return a * b;
+  }
+  static V div(V a, V b)
+  {
+    return a / b;
+  }
+  static V neg(V a)
+  {
+    return -a;
+  }
+  static V sqrt(V a)
+  {
+    return std::sqrt(a);
+  }
+  static V abs(V a)
+  {
+    return std::abs(a);
+  }
+  static M lt(V a, V b)
+  {
+    return a < b ? 1. : 0.;
+  }
+  static M le(V a, V b)
+  {
+    return a <= b ? 1. : 0.;
+  }
+  static M gt(V a, V b)
+  {
+    return a > b ? 1. : 0.;
+  }
+  static M ge(V a, V b)
+  {
+    return a >= b ? 1. : 0.;
+  }
+  static M ne(V a, V b)
+  {
+    return a != b ? 1. : 0.;
+  }
+  static M and_(M a, M b)
+  {
+    return a * b;
+  }
+  static V select(M m, V a, V b)
+  {
+    return m != 0. ? a : b;
+  }
+};
+
+Coeff as_coeff(Barrier const& b)
+{
+  auto const coeff = b.pol().coeff();
+  return {coeff[0], coeff.size() > 1 ? coeff[1] : 0.,
+          coeff.size() > 2 ? coeff[2] : 0.};
+}
+
+void simulate_block(BounceStep step, Barrier const& barrier_up,
+                    Barrier const& barrier_down, Coeff const& up,
+                    Coeff const& down, double const* y0, double const* theta0,
+                    double* x, double* y, double* theta, std::size_t n)
+{
+  std::array<Lanes, 2> lanes;
+  Lanes* s{&lanes[0]};
+  Lanes* next{&lanes[1]};
+  for (std::size_t i{0}; i < n; ++i) {
+    assert(std::abs(y0[i]) < barrier_up.pol()(0.));
+    s->px[i]     = 0.;
+    s->py[i]     = y0[i];
+    s->vx[i]     = std::cos(theta0[i]);
+    s->vy[i]     = std::sin(theta0[i]);
+    s->scalar[i] = std::abs(s->vx[i]) < Globals::EPS ? 1. : 0.;
+    s->active[i] = 1. - s->scalar[i];
+  }
+  // the kernels work on whole vectors: the lanes after the last particle are
+  // filled with finished particles
+  std::size_t const padded{(n + MAX_WIDTH - 1) / MAX_WIDTH * MAX_WIDTH};
+  for (std::size_t i{n}; i < padded; ++i) {
+    s->px[i]     = 0.;
+    s->py[i]     = 0.;
+    s->vx[i]     = 1.;
+    s->vy[i]     = 0.;
+    s->scalar[i] = 0.;
+    s->active[i] = 0.;
+  }
+
+  double const l{barrier_up.max()};
+  for (int it{0}; it < Globals::MAX_ITERATIONS; ++it) {
+    if (std::none_of(s->active.begin(), s->active.begin() + n,
+                     [](double a) { return a != 0.; })) {
+      break;
+    }
+    step(*s, *next, padded, up, down, l);
+    std::swap(s, next);
+  }
+
+  for (std::size_t i{0}; i < n; ++i) {
+    if (s->scalar[i] != 0.) {
+      Result res = simulate_single_particle(barrier_up, barrier_down,
+                                            {{0., y0[i]}, theta0[i]});
+      x[i]       = res.get_x();
+      y[i]       = res.get_y();
+      theta[i]   = res.get_theta();
+    } else {
+      x[i]     = s->px[i];
+      y[i]     = s->py[i];
+      theta[i] = std::atan2(s->vy[i], s->vx[i]);
+    }
+  }
+}
+
+} // namespace
+
+void bounce_step_scalar(Lanes const& s, Lanes& out, std::size_t n,
+                        Coeff const& up, Coeff const& down, double l)
+{
+  bounce_step<Scalar>(s, out, n, up, down, l);
+}
+
+std::vector<BounceStep> bounce_steps()
+{
+  std::vector<BounceStep> steps{bounce_step_scalar};
+#ifdef X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    steps.push_back(bounce_step_avx2);
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    steps.push_back(bounce_step_avx512);
+  }
+#endif
+  return steps;
+}
+
+void simulate_batch(Barrier const& barrier_up, Barrier const& barrier_down,
+                    std::span<double const> y0,
+                    std::span<double const> theta0, std::span<double> x,
+                    std::span<double> y, std::span<double> theta)
+{
+  std::size_t const n{y0.size()};
+  assert(theta0.size() == n && x.size() == n && y.size() == n
+         && theta.size() == n);
+
+  if (barrier_up.pol().deg() > 2 || barrier_down.pol().deg() > 2) {
+    for (std::size_t i{0}; i != n; ++i) {
+      Result res = simulate_single_particle(barrier_up, barrier_down,
+                                            {{0., y0[i]}, theta0[i]});
+      x[i]       = res.get_x();
+      y[i]       = res.get_y();
+      theta[i]   = res.get_theta();
+    }
+    return;
+  }
+
+  // the widest kernel supported by the CPU, chosen once
+  static BounceStep const step{bounce_steps().back()};
+  Coeff const up{as_coeff(barrier_up)};
+  Coeff const down{as_coeff(barrier_down)};
+  for (std::size_t first{0}; first < n; first += BLOCK) {
+    std::size_t const size{std::min(BLOCK, n - first)};
+    simulate_block(step, barrier_up, barrier_down, up, down, &y0[first],
+                   &theta0[first], &x[first], &y[first], &theta[first], size);
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// internals of simulate_batch, shared by the kernels compiled for the
+// different instruction sets
+
+// lanes simulated together, the state of a block fits in the L1 cache: a
+// multiple of the widest vector (8 doubles)
+constexpr std::size_t BLOCK{128};
+constexpr std::size_t MAX_WIDTH{8};
+
+// y = c0 + c1 * x + c2 * x^2, for barriers of degree up to 2
+struct Coeff
+{
+  double c0;
+  double c1;
+  double c2;
+};
+
+// state of a block of particles, one array per component
+struct Lanes
+{
+  std::array<double, BLOCK> px;
+  std::array<double, BLOCK> py;
+  std::array<double, BLOCK> vx;
+  std::array<double, BLOCK> vy;
+  // 1 while the particle is bouncing; flags are stored as doubles, so that
+  // every lane fits the same vector registers
+  std::array<double, BLOCK> active;
+  // 1 if the particle must be simulated by simulate_single_particle
+  std::array<double, BLOCK> scalar;
+};
+
+// one iteration of the bounce loop of simulate_single_particle on the first n
+// lanes of s, n being a multiple of MAX_WIDTH: the new state is written in out
+using BounceStep = void (*)(Lanes const& s, Lanes& out, std::size_t n,
+                            Coeff const& up, Coeff const& down, double l);
+
+void bounce_step_scalar(Lanes const& s, Lanes& out, std::size_t n,
+                        Coeff const& up, Coeff const& down, double l);
+void bounce_step_avx2(Lanes const& s, Lanes& out, std::size_t n,
+                      Coeff const& up, Coeff const& down, double l);
+void bounce_step_avx512(Lanes const& s, Lanes& out, std::size_t n,
+                        Coeff const& up, Coeff const& down, double l);
+
+// the kernels supported by this CPU, from the scalar one to the widest one
+std::vector<BounceStep> bounce_steps();
+
+#endif
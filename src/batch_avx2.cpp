@@ -0,0 +1,91 @@
+#include "batch.hpp"
+#include "batch_kernel.hpp"
+#include <immintrin.h>
+
+// compiled with -mavx2: called only if the CPU supports it (bounce_steps)
+
+namespace {
+
+struct Avx2
+{
+  using V = __m256d;
+  using M = __m256d;
+  static constexpr std::size_t width{4};
+
+  static V load(double const* p)
+  {
+    return _mm256_loadu_pd(p);
+  }
+  static void store(double* p, V v)
+  {
+    _mm256_storeu_pd(p, v);
+  }
+  static V set1(double x)
+  {
+    return _mm256_set1_pd(x);
+  }
+  static V add(V a, V b)
+  {
+    return _mm256_add_pd(a, b);
+  }
+  static V sub(V a, V b)
+  {
+    return _mm256_sub_pd(a, b);
+  }
+  static V mul(V a, V b)
+  {
+    return _mm256_mul_pd(a, b);
+  }
+  static V div(V a, V b)
+  {
+    return _mm256_div_pd(a, b);
+  }
+  static V neg(V a)
+  {
+    return _mm256_xor_pd(a, _mm256_set1_pd(-0.));
+  }
+  static V sqrt(V a)
+  {
+    return _mm256_sqrt_pd(a);
+  }
+  static V abs(V a)
+  {
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.), a);
+  }
+  static M lt(V a, V b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+  }
+  static M le(V a, V b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_LE_OQ);
+  }
+  static M gt(V a, V b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+  }
+  static M ge(V a, V b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_GE_OQ);
+  }
+  static M ne(V a, V b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_NEQ_UQ);
+  }
+  static M and_(M a, M b)
+  {
+    return _mm256_and_pd(a, b);
+  }
+  static V select(M m, V a, V b)
+  {
+    return _mm256_blendv_pd(b, a, m);
+  }
+};
+
+} // namespace
+
+void bounce_step_avx2(Lanes const& s, Lanes& out, std::size_t n,
+                      Coeff const& up, Coeff const& down, double l)
+{
+  bounce_step<Avx2>(s, out, n, up, down, l);
+}
@@ -0,0 +1,95 @@
+#include "batch.hpp"
+#include "batch_kernel.hpp"
+#include <immintrin.h>
+
+// compiled with -mavx512f: called only if the CPU supports it (bounce_steps)
+
+namespace {
+
+struct Avx512
+{
+  using V = __m512d;
+  using M = __mmask8;
+  static constexpr std::size_t width{8};
+
+  static V load(double const* p)
+  {
+    return _mm512_loadu_pd(p);
+  }
+  static void store(double* p, V v)
+  {
+    _mm512_storeu_pd(p, v);
+  }
+  static V set1(double x)
+  {
+    return _mm512_set1_pd(x);
+  }
+  static V add(V a, V b)
+  {
+    return _mm512_add_pd(a, b);
+  }
+  static V sub(V a, V b)
+  {
+    return _mm512_sub_pd(a, b);
+  }
+  static V mul(V a, V b)
+  {
+    return _mm512_mul_pd(a, b);
+  }
+  static V div(V a, V b)
+  {
+    return _mm512_div_pd(a, b);
+  }
+  static V neg(V a)
+  {
+    return _mm512_castsi512_pd(
+        _mm512_xor_si512(_mm512_castpd_si512(a),
+                         _mm512_castpd_si512(_mm512_set1_pd(-0.))));
+  }
+  static V sqrt(V a)
+  {
+    // same instruction as _mm512_sqrt_pd, whose undefined pass-through
+    // operand makes gcc 12 warn with -Wmaybe-uninitialized
+    return _mm512_mask_sqrt_pd(a, 0xFF, a);
+  }
+  static V abs(V a)
+  {
+    return _mm512_abs_pd(a);
+  }
+  static M lt(V a, V b)
+  {
+    return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ);
+  }
+  static M le(V a, V b)
+  {
+    return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ);
+  }
+  static M gt(V a, V b)
+  {
+    return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);
+  }
+  static M ge(V a, V b)
+  {
+    return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ);
+  }
+  static M ne(V a, V b)
+  {
+    return _mm512_cmp_pd_mask(a, b, _CMP_NEQ_UQ);
+  }
+  static M and_(M a, M b)
+  {
+    return a & b;
+  }
+  static V select(M m, V a, V b)
+  {
+    return _mm512_mask_blend_pd(m, b, a);
+  }
+};
+
+} // namespace
+
+void bounce_step_avx512(Lanes const& s, Lanes& out, std::size_t n,
+                        Coeff const& up, Coeff const& down, double l)
+{
+  bounce_step<Avx512>(s, out, n, up, down, l);
+}
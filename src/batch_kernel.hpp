@@ -0,0 +1,163 @@
+#ifndef BATCH_KERNEL_HPP
+#define BATCH_KERNEL_HPP
+
+#include "batch.hpp"
+#include "globals.hpp"
+#include <cmath>
+#include <limits>
+
+// bounce step written once for any vector type S, which provides:
+//   V, M                       vector of doubles and mask
+//   width                      number of lanes in V
+//   load, store, set1          memory access and broadcast
+//   add, sub, mul, div, neg    arithmetic, as the scalar operators
+//   sqrt, abs
+//   lt, le, gt, ge, ne         comparisons, false on NaN except ne
+//   and_, select               mask operations, select(m, a, b) = m ? a : b
+// every operation is exactly rounded, so all the kernels give the same
+// results, bit by bit
+
+// the same operations as intersect/eq_solve for a quadratic or linear barrier,
+// with both candidate roots always computed: a missing root is NaN, which
+// fails every later comparison. Whether the barrier is linear (|c2| < EPS) is
+// the same for every lane, so it is a template parameter
+template<typename S, bool Linear>
+inline void roots(Coeff const& b, typename S::V m, typename S::V q,
+                  typename S::V& r0, typename S::V& r1)
+{
+  using V = typename S::V;
+  V const zero{S::set1(0.)};
+  V const none{S::set1(std::numeric_limits<double>::quiet_NaN())};
+  V const eps{S::set1(Globals::EPS)};
+
+  V const bb{S::sub(S::set1(b.c1), m)};
+  V const c{S::sub(S::set1(b.c0), q)};
+  if constexpr (Linear) {
+    r0 = S::select(S::ge(S::abs(bb), eps), S::div(S::neg(c), bb), none);
+    r1 = none;
+  } else {
+    V const two_a{S::set1(2. * b.c2)};
+    V const disc{S::sub(S::mul(bb, bb), S::mul(S::set1(4. * b.c2), c))};
+    // std::max(disc, 0.)
+    V const sqrt_disc{S::sqrt(S::select(S::lt(disc, zero), zero, disc))};
+    V const single{S::div(S::neg(bb), two_a)};
+    V const first{S::select(S::lt(disc, eps), single,
+                            S::div(S::sub(S::neg(bb), sqrt_disc), two_a))};
+    V const second{S::select(S::lt(disc, eps), none,
+                             S::div(S::add(S::neg(bb), sqrt_disc), two_a))};
+    r0 = S::select(S::lt(disc, zero), none, first);
+    r1 = second;
+  }
+}
+
+template<typename S, bool UpLinear, bool DownLinear>
+inline void bounce_loop(Lanes const& s, Lanes& out, std::size_t n,
+                        Coeff const& up_ref, Coeff const& down_ref, double l)
+{
+  using V = typename S::V;
+  // local copies, which cannot alias out
+  Coeff const up{up_ref};
+  Coeff const down{down_ref};
+  V const zero{S::set1(0.)};
+  V const one{S::set1(1.)};
+  V const inf{S::set1(std::numeric_limits<double>::infinity())};
+  V const eps{S::set1(Globals::EPS)};
+  V const len{S::set1(l)};
+
+  for (std::size_t i{0}; i < n; i += S::width) {
+    V const px{S::load(&s.px[i])};
+    V const py{S::load(&s.py[i])};
+    V const vx{S::load(&s.vx[i])};
+    V const vy{S::load(&s.vy[i])};
+    V const active{S::load(&s.active[i])};
+    V const scalar{S::load(&s.scalar[i])};
+    auto const right = S::gt(vx, zero);
+    V const dir{S::select(right, one, S::neg(one))};
+
+    V const m{S::div(vy, vx)};
+    V const q{S::sub(py, S::mul(m, px))};
+
+    // nearest valid collision, in the same order as simulate_single_particle:
+    // the particle is always in [0, l], so x > 0 is equivalent to the x >= 0
+    // of intersect when moving rightwards
+    V best{inf};
+    V bx{zero};
+    V by{zero};
+    V bder{zero};
+    auto const candidate = [&](V x, Coeff const& b) {
+      V const y{S::add(S::mul(m, x), q)};
+      V const dx{S::sub(x, px)};
+      V const dy{S::sub(y, py)};
+      // the distance of an invalid collision is infinite
+      V d2{S::add(S::mul(dx, dx), S::mul(dy, dy))};
+      d2 = S::select(S::gt(S::mul(dir, dx), eps), d2, inf);
+      d2 = S::select(S::gt(x, zero), d2, inf);
+      d2 = S::select(S::le(x, len), d2, inf);
+      auto const take = S::lt(d2, best);
+      V const der{S::add(S::mul(S::set1(2 * b.c2), x), S::set1(b.c1))};
+      bx   = S::select(take, x, bx);
+      by   = S::select(take, y, by);
+      bder = S::select(take, der, bder);
+      best = S::select(take, d2, best);
+    };
+
+    V r0;
+    V r1;
+    roots<S, UpLinear>(up, m, q, r0, r1);
+    candidate(r0, up);
+    if constexpr (!UpLinear) {
+      candidate(r1, up);
+    }
+    roots<S, DownLinear>(down, m, q, r0, r1);
+    candidate(r0, down);
+    if constexpr (!DownLinear) {
+      candidate(r1, down);
+    }
+
+    // reflect across the tangent (1, bder), as Vec2::reflect on its normal
+    V const inv_norm{S::div(one, S::sqrt(S::add(one, S::mul(bder, bder))))};
+    V const tgx{inv_norm};
+    V const tgy{S::mul(bder, inv_norm)};
+    V const nx{S::neg(tgy)};
+    V const ny{tgx};
+    V const vn{S::add(S::mul(vx, nx), S::mul(vy, ny))};
+    V const k{S::add(vn, vn)};
+    V const bvx{S::sub(vx, S::mul(k, nx))};
+    V const bvy{S::sub(vy, S::mul(k, ny))};
+
+    // or exit
+    V const ex{S::select(right, len, zero)};
+    V const ey{S::add(py, S::mul(S::div(S::sub(ex, px), vx), vy))};
+
+    auto const live = S::ne(active, zero);
+    auto const bounce = S::and_(live, S::lt(best, inf));
+    auto const vertical = S::lt(S::abs(bvx), eps);
+    S::store(&out.px[i], S::select(bounce, bx, S::select(live, ex, px)));
+    S::store(&out.py[i], S::select(bounce, by, S::select(live, ey, py)));
+    S::store(&out.vx[i], S::select(bounce, bvx, vx));
+    S::store(&out.vy[i], S::select(bounce, bvy, vy));
+    S::store(&out.active[i],
+             S::select(bounce, S::select(vertical, zero, one), zero));
+    S::store(&out.scalar[i],
+             S::select(S::and_(bounce, vertical), one, scalar));
+  }
+}
+
+template<typename S>
+inline void bounce_step(Lanes const& s, Lanes& out, std::size_t n,
+                        Coeff const& up, Coeff const& down, double l)
+{
+  bool const up_linear{std::abs(up.c2) < Globals::EPS};
+  bool const down_linear{std::abs(down.c2) < Globals::EPS};
+  if (up_linear && down_linear) {
+    bounce_loop<S, true, true>(s, out, n, up, down, l);
+  } else if (up_linear) {
+    bounce_loop<S, true, false>(s, out, n, up, down, l);
+  } else if (down_linear) {
+    bounce_loop<S, false, true>(s, out, n, up, down, l);
+  } else {
+    bounce_loop<S, false, false>(s, out, n, up, down, l);
+  }
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include "counters.hpp"
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace Counters {
+
+namespace {
+
+constexpr std::array<char const*, N_EVENTS> NAMES{
+    "particles",     "unfolded",   "bounces",   "max_iterations", "vertical",
+    "intersections", "slab_skips", "eq_solves", "roots_found",
+    "roots_rejected"};
+
+struct Registry
+{
+  std::mutex m;
+  std::vector<Block*> blocks;
+  Counts exited{};
+};
+
+// never destroyed: blocks of threads exiting after main are still removed
+Registry& registry()
+{
+  static Registry* r{new Registry};
+  return *r;
+}
+
+} // namespace
+
+#ifdef BILIARDO_COUNTERS
+thread_local Block block;
+#endif
+
+Block::Block()
+{
+  Registry& r = registry();
+  std::lock_guard lock{r.m};
+  r.blocks.push_back(this);
+}
+
+Block::~Block()
+{
+  Registry& r = registry();
+  std::lock_guard lock{r.m};
+  for (std::size_t i{0}; i != N_EVENTS; ++i) {
+    r.exited[i] += counts[i];
+  }
+  r.blocks.erase(std::find(r.blocks.begin(), r.blocks.end(), this));
+}
+
+Counts total()
+{
+  Registry& r = registry();
+  std::lock_guard lock{r.m};
+  Counts res{r.exited};
+  for (Block const* b : r.blocks) {
+    for (std::size_t i{0}; i != N_EVENTS; ++i) {
+      res[i] += b->counts[i];
+    }
+  }
+  return res;
+}
+
+void reset()
+{
+  Registry& r = registry();
+  std::lock_guard lock{r.m};
+  r.exited = {};
+  for (Block* b : r.blocks) {
+    b->counts = {};
+  }
+}
+
+void report(std::ostream& os, double seconds)
+{
+  Counts const counts{total()};
+  for (std::size_t i{0}; i != N_EVENTS; ++i) {
+    os << (i == 0 ? "" : " ") << NAMES[i] << '=' << counts[i];
+  }
+  auto const value = [&](Event e) {
+    return static_cast<double>(counts[static_cast<std::size_t>(e)]);
+  };
+  double const particles{value(Event::particles) + value(Event::unfolded)};
+  os << " seconds=" << seconds
+     << " particles_per_second=" << (seconds > 0. ? particles / seconds : 0.)
+     << " bounces_per_particle="
+     << (value(Event::particles) > 0.
+             ? value(Event::bounces) / value(Event::particles)
+             : 0.);
+}
+
+} // namespace Counters
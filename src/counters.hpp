@@ -0,0 +1,80 @@
+#ifndef COUNTERS_HPP
+#define COUNTERS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// counters of the events of the hot paths of the simulation, compiled in only
+// with the cmake option BILIARDO_COUNTERS: otherwise add() is empty, every
+// call to it is removed by the compiler and there is no thread-local storage
+namespace Counters {
+
+#ifdef BILIARDO_COUNTERS
+constexpr bool ENABLED{true};
+#else
+constexpr bool ENABLED{false};
+#endif
+
+enum class Event : std::size_t
+{
+  // calls of simulate_single_particle, and particles simulated by Unfolding
+  // without falling back to it
+  particles,
+  unfolded,
+  bounces,
+  // runs of simulate_single_particle stopped at Globals::MAX_ITERATIONS
+  max_iterations,
+  vertical,
+  // intersections of a trajectory with a barrier, and the ones ruled out by
+  // the slab test before solving
+  intersections,
+  slab_skips,
+  eq_solves,
+  // roots of eq_solve for an intersection, and the ones behind the particle
+  // or out of the barrier
+  roots_found,
+  roots_rejected,
+  count
+};
+
+constexpr std::size_t N_EVENTS{static_cast<std::size_t>(Event::count)};
+using Counts = std::array<std::uint64_t, N_EVENTS>;
+
+// counts of a thread: registered at the first event of the thread, and added
+// to the counts of the exited threads when it exits
+struct Block
+{
+  Counts counts{};
+
+  Block();
+  ~Block();
+  Block(Block const&)            = delete;
+  Block& operator=(Block const&) = delete;
+};
+
+#ifdef BILIARDO_COUNTERS
+// defined in counters.cpp: an inline variable would make every translation
+// unit including this header, e.g. the ones of output, need Block()
+extern thread_local Block block;
+#endif
+
+inline void add([[maybe_unused]] Event e, [[maybe_unused]] std::uint64_t n = 1)
+{
+#ifdef BILIARDO_COUNTERS
+  block.counts[static_cast<std::size_t>(e)] += n;
+#endif
+}
+
+// sum of the counts of every thread; the threads must not be simulating, e.g.
+// after ThreadPool::parallel_for returned
+Counts total();
+void reset();
+
+// key=value pairs of total(), with the particles simulated per second
+void report(std::ostream& os, double seconds);
+
+} // namespace Counters
+
+#endif
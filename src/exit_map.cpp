@@ -0,0 +1,384 @@
+#include "exit_map.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+// the file is the in-memory layout
+static_assert(std::endian::native == std::endian::little,
+              "the exit map is little endian");
+static_assert(sizeof(ExitMap::Header) % alignof(ExitMap::Leaf) == 0);
+static_assert(sizeof(ExitMap::Node) % alignof(ExitMap::Leaf) == 0);
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC{'B', 'I', 'L', 'I', 'M', 'A', 'P', '\0'};
+constexpr std::uint32_t VERSION{1};
+// sampled points are moved this far (relative to the domain) inside the
+// domain: y0 on a barrier or vertical trajectories cannot be simulated
+constexpr double MARGIN{1e-9};
+// nodes and leaves are indexed by 32-bit integers
+constexpr std::uint64_t MAX_INDEX{std::numeric_limits<std::uint32_t>::max()};
+
+std::array<double, Globals::MAX_DEGREE + 1> padded(Pol const& pol)
+{
+  std::array<double, Globals::MAX_DEGREE + 1> result{};
+  std::ranges::copy(pol.coeff(), result.begin());
+  return result;
+}
+
+// cells of the top grid are split at most this many times along each side
+std::uint32_t finest(ExitMapOptions const& options)
+{
+  return std::uint32_t{1} << (options.max_depth - options.min_depth);
+}
+
+// exact result at a point of the lattice
+struct Eval
+{
+  bool right;
+  // number of bounces (high bits) and walls of the first 32 of them, 1 for
+  // the upper one: points with the same pattern follow the same bounce
+  // sequence, along which the map is smooth
+  std::uint64_t pattern;
+  double y;
+  double theta;
+};
+
+// builds the quadtree of one cell of the top grid; node 0 is its root
+class Builder
+{
+  Barrier const& barrier_up_;
+  Barrier const& barrier_down_;
+  ExitMapOptions const& options_;
+  ExitMap::Header const& header_;
+  // lattice step in y0 and theta0, half the size of the finest cells, so that
+  // their center and edge midpoints are on the lattice
+  double dy_;
+  double dtheta_;
+  std::vector<Vec2> bounces_;
+  std::unordered_map<std::uint64_t, Eval> cache_;
+
+  Eval const& eval(std::uint32_t i, std::uint32_t j)
+  {
+    std::uint64_t const key{std::uint64_t{i} << 32 | j};
+    if (auto it = cache_.find(key); it != cache_.end()) {
+      return it->second;
+    }
+
+    double const y_margin{MARGIN * (header_.y_hi - header_.y_lo)};
+    double const y0{std::clamp(header_.y_lo + i * dy_, header_.y_lo + y_margin,
+                               header_.y_hi - y_margin)};
+    double const theta0{header_.theta_lo + j * dtheta_};
+    bounces_.clear();
+    Result const res{simulate_single_particle(
+        barrier_up_, barrier_down_, Trajectory{{0., y0}, theta0}, &bounces_)};
+
+    Eval e{res.get_x() == barrier_up_.max(),
+           std::uint64_t{bounces_.size()} << 32, res.get_y(), res.get_theta()};
+    for (std::size_t b{0}; b != std::min(bounces_.size(), std::size_t{32});
+         ++b) {
+      e.pattern |= std::uint64_t{bounces_[b].y_ > 0.} << b;
+    }
+    return cache_.emplace(key, e).first->second;
+  }
+
+ public:
+  std::vector<ExitMap::Node> nodes;
+  std::vector<ExitMap::Leaf> leaves;
+
+  Builder(Barrier const& barrier_up, Barrier const& barrier_down,
+          ExitMapOptions const& options, ExitMap::Header const& header)
+      : barrier_up_{barrier_up}
+      , barrier_down_{barrier_down}
+      , options_{options}
+      , header_{header}
+  {
+    double const n{static_cast<double>(header.top)
+                   * static_cast<double>(finest(options) * 2)};
+    dy_     = (header.y_hi - header.y_lo) / n;
+    dtheta_ = (header.theta_hi - header.theta_lo) / n;
+    nodes.push_back({0, 0});
+  }
+
+  // cell [i, i + size] x [j, j + size] of the lattice, stored in nodes[node]
+  void build(std::size_t node, std::uint32_t i, std::uint32_t j,
+             std::uint32_t size)
+  {
+    std::array<Eval, 4> const c{eval(i, j), eval(i + size, j),
+                                eval(i, j + size), eval(i + size, j + size)};
+    auto same = [&](Eval const& e) {
+      return e.right == c[0].right && (!e.right || e.pattern == c[0].pattern);
+    };
+    bool uniform{std::all_of(c.begin(), c.end(), same)};
+    bool accurate{true};
+
+    // center and midpoints of the edges, at (u, v) in the cell
+    std::uint32_t const h{size / 2};
+    std::array<std::array<std::uint32_t, 2>, 5> const checks{
+        {{h, h}, {h, 0}, {0, h}, {size, h}, {h, size}}};
+    for (auto const& [di, dj] : checks) {
+      Eval const& e = eval(i + di, j + dj);
+      uniform = uniform && same(e);
+      if (uniform && e.right) {
+        double const u{static_cast<double>(di) / size};
+        double const v{static_cast<double>(dj) / size};
+        auto interpolate = [&](auto member) {
+          return (1. - u) * (1. - v) * c[0].*member
+               + u * (1. - v) * c[1].*member + (1. - u) * v * c[2].*member
+               + u * v * c[3].*member;
+        };
+        double const tolerance{options_.tolerance};
+        accurate = accurate
+                && std::abs(interpolate(&Eval::y) - e.y) <= tolerance
+                && std::abs(interpolate(&Eval::theta) - e.theta) <= tolerance;
+      }
+    }
+
+    if ((uniform && accurate) || size == 2) {
+      ExitMap::Leaf leaf{};
+      if (!uniform || !accurate) {
+        leaf.kind = ExitMap::Kind::mixed;
+      } else {
+        leaf.kind = c[0].right ? ExitMap::Kind::right : ExitMap::Kind::left;
+      }
+      for (std::size_t k{0}; k != 4; ++k) {
+        leaf.yf[k]     = c[k].y;
+        leaf.thetaf[k] = c[k].theta;
+      }
+      nodes[node] = {0, static_cast<std::uint32_t>(leaves.size())};
+      leaves.push_back(leaf);
+      return;
+    }
+
+    std::size_t const first{nodes.size()};
+    nodes[node] = {static_cast<std::uint32_t>(first), 0};
+    nodes.resize(first + 4);
+    for (std::uint32_t q{0}; q != 4; ++q) {
+      build(first + q, i + (q & 1) * h, j + (q >> 1) * h, h);
+    }
+  }
+};
+
+} // namespace
+
+void ExitMap::Unmap::operator()(void* p) const
+{
+  munmap(p, size);
+}
+
+ExitMap ExitMap::build(Barrier const& barrier_up, Barrier const& barrier_down,
+                       ExitMapOptions const& options, ThreadPool& pool)
+{
+  if (options.min_depth < 0 || options.max_depth < options.min_depth
+      || options.max_depth > 24) {
+    throw std::invalid_argument{"The depths of the exit map must satisfy "
+                                "0 <= min_depth <= max_depth <= 24"};
+  }
+  // the roots of the top grid alone take 4^min_depth node indices: checked
+  // before the grid is allocated
+  if ((std::uint64_t{1} << (2 * options.min_depth)) > MAX_INDEX) {
+    throw std::invalid_argument{"The top grid of the exit map is too large: "
+                                "min_depth must be at most 15"};
+  }
+
+  ExitMap result;
+  Header& h = result.header_;
+  h.magic    = MAGIC;
+  h.version  = VERSION;
+  h.top      = std::uint32_t{1} << options.min_depth;
+  h.y_lo     = barrier_down.pol()(0.);
+  h.y_hi     = barrier_up.pol()(0.);
+  h.theta_lo = -std::numbers::pi / 2. * (1. - MARGIN);
+  h.theta_hi = std::numbers::pi / 2. * (1. - MARGIN);
+  h.l        = barrier_up.max();
+  h.up       = padded(barrier_up.pol());
+  h.down     = padded(barrier_down.pol());
+
+  std::uint32_t const top{h.top};
+  std::uint32_t const size{finest(options) * 2};
+  std::vector<std::vector<Node>> nodes(std::size_t{top} * top);
+  std::vector<std::vector<Leaf>> leaves(nodes.size());
+  pool.parallel_for(nodes.size(), [&](std::size_t cell) {
+    Builder builder{barrier_up, barrier_down, options, h};
+    builder.build(0, static_cast<std::uint32_t>(cell % top) * size,
+                  static_cast<std::uint32_t>(cell / top) * size, size);
+    nodes[cell]  = std::move(builder.nodes);
+    leaves[cell] = std::move(builder.leaves);
+  });
+
+  // roots first, at the index of their cell, then the other nodes of each
+  // quadtree, whose indices are shifted
+  std::size_t n_nodes{nodes.size()};
+  std::size_t n_leaves{0};
+  for (std::size_t cell{0}; cell != nodes.size(); ++cell) {
+    n_nodes += nodes[cell].size() - 1;
+    n_leaves += leaves[cell].size();
+  }
+  if (n_nodes > MAX_INDEX || n_leaves > MAX_INDEX) {
+    throw std::runtime_error{"The exit map is too large"};
+  }
+  result.owned_nodes_.resize(nodes.size());
+  result.owned_nodes_.reserve(n_nodes);
+  result.owned_leaves_.reserve(n_leaves);
+  for (std::size_t cell{0}; cell != nodes.size(); ++cell) {
+    auto const node_shift =
+        static_cast<std::uint32_t>(result.owned_nodes_.size() - 1);
+    auto const leaf_shift =
+        static_cast<std::uint32_t>(result.owned_leaves_.size());
+    auto shift = [&](Node n) {
+      return n.first_child == 0 ? Node{0, n.leaf + leaf_shift}
+                                : Node{n.first_child + node_shift, 0};
+    };
+    result.owned_nodes_[cell] = shift(nodes[cell][0]);
+    std::transform(nodes[cell].begin() + 1, nodes[cell].end(),
+                   std::back_inserter(result.owned_nodes_), shift);
+    result.owned_leaves_.insert(result.owned_leaves_.end(),
+                                leaves[cell].begin(), leaves[cell].end());
+  }
+
+  h.n_nodes      = result.owned_nodes_.size();
+  h.n_leaves     = result.owned_leaves_.size();
+  result.nodes_  = result.owned_nodes_;
+  result.leaves_ = result.owned_leaves_;
+  return result;
+}
+
+ExitMap ExitMap::map(std::string const& path)
+{
+  int const fd{open(path.c_str(), O_RDONLY)};
+  if (fd < 0) {
+    throw std::runtime_error{"Cannot open " + path};
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+    close(fd);
+    throw std::runtime_error{path + " is not a valid exit map"};
+  }
+  auto const size = static_cast<std::size_t>(st.st_size);
+  void* const data{mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error{"Cannot map " + path};
+  }
+
+  ExitMap result;
+  result.mapping_ = {data, Unmap{size}};
+  auto const bytes = static_cast<char const*>(data);
+  std::memcpy(&result.header_, bytes, sizeof(Header));
+  Header const& h = result.header_;
+  bool valid{h.magic == MAGIC && h.version == VERSION && h.top != 0
+             && h.n_nodes >= std::uint64_t{h.top} * h.top
+             && h.n_nodes < MAX_INDEX && h.n_leaves < MAX_INDEX
+             // finite, non-empty ranges, which lookup divides by
+             && h.y_lo < h.y_hi && std::isfinite(h.y_hi - h.y_lo)
+             && h.theta_lo < h.theta_hi
+             && std::isfinite(h.theta_hi - h.theta_lo)
+             && size
+                    == sizeof(Header) + h.n_nodes * sizeof(Node)
+                           + h.n_leaves * sizeof(Leaf)};
+  if (valid) {
+    result.nodes_  = {reinterpret_cast<Node const*>(bytes + sizeof(Header)),
+                   static_cast<std::size_t>(h.n_nodes)};
+    result.leaves_ = {reinterpret_cast<Leaf const*>(
+                       bytes + sizeof(Header) + h.n_nodes * sizeof(Node)),
+                   static_cast<std::size_t>(h.n_leaves)};
+    // lookup does not check the indices; children follow their parent, so
+    // that descending the tree always ends
+    for (std::size_t k{0}; valid && k != result.nodes_.size(); ++k) {
+      Node const n{result.nodes_[k]};
+      valid = n.first_child == 0 ? n.leaf < h.n_leaves
+                                 : n.first_child > k
+                                       && n.first_child + std::uint64_t{3}
+                                              < h.n_nodes;
+    }
+  }
+  if (!valid) {
+    throw std::runtime_error{path + " is not a valid exit map"};
+  }
+  return result;
+}
+
+void ExitMap::save(std::string const& path) const
+{
+  std::ofstream file{path, std::ios::binary};
+  if (!file) {
+    throw std::runtime_error{"Cannot open " + path};
+  }
+  file.write(reinterpret_cast<char const*>(&header_), sizeof(Header));
+  file.write(reinterpret_cast<char const*>(nodes_.data()),
+             static_cast<std::streamsize>(nodes_.size_bytes()));
+  file.write(reinterpret_cast<char const*>(leaves_.data()),
+             static_cast<std::streamsize>(leaves_.size_bytes()));
+  file.close();
+  if (!file) {
+    throw std::runtime_error{"Error writing the exit map"};
+  }
+}
+
+bool ExitMap::matches(Barrier const& barrier_up,
+                      Barrier const& barrier_down) const
+{
+  return header_.l == barrier_up.max() && header_.l == barrier_down.max()
+      && header_.up == padded(barrier_up.pol())
+      && header_.down == padded(barrier_down.pol());
+}
+
+std::size_t ExitMap::n_leaves() const
+{
+  return leaves_.size();
+}
+
+std::optional<MapExit> ExitMap::lookup(double y0, double theta0) const
+{
+  Header const& h = header_;
+  if (!(y0 >= h.y_lo && y0 <= h.y_hi && theta0 >= h.theta_lo
+        && theta0 <= h.theta_hi)) {
+    return std::nullopt;
+  }
+
+  // position in the top grid, then in the cell
+  double const top{static_cast<double>(h.top)};
+  double u{(y0 - h.y_lo) / (h.y_hi - h.y_lo) * top};
+  double v{(theta0 - h.theta_lo) / (h.theta_hi - h.theta_lo) * top};
+  std::uint32_t const i{std::min(static_cast<std::uint32_t>(u), h.top - 1)};
+  std::uint32_t const j{std::min(static_cast<std::uint32_t>(v), h.top - 1)};
+  u -= i;
+  v -= j;
+
+  Node node{nodes_[std::size_t{j} * h.top + i]};
+  while (node.first_child != 0) {
+    u *= 2.;
+    v *= 2.;
+    std::uint32_t const qi{u >= 1.};
+    std::uint32_t const qj{v >= 1.};
+    u -= qi;
+    v -= qj;
+    node = nodes_[node.first_child + 2 * qj + qi];
+  }
+
+  Leaf const& leaf = leaves_[node.leaf];
+  switch (leaf.kind) {
+  case Kind::right: {
+    auto interpolate = [&](std::array<double, 4> const& c) {
+      return (1. - u) * (1. - v) * c[0] + u * (1. - v) * c[1]
+           + (1. - u) * v * c[2] + u * v * c[3];
+    };
+    return MapExit{true, interpolate(leaf.yf), interpolate(leaf.thetaf)};
+  }
+  case Kind::left:
+    return MapExit{false, 0., 0.};
+  default:
+    return std::nullopt;
+  }
+}
@@ -0,0 +1,128 @@
+#ifndef EXIT_MAP_HPP
+#define EXIT_MAP_HPP
+
+#include "globals.hpp"
+#include "kinematics.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+struct ExitMapOptions
+{
+  // largest interpolation error of yf and thetaf at the points checked in a
+  // cell before it is split
+  double tolerance{1e-4};
+  // the domain is first split in a grid of 2^min_depth x 2^min_depth cells,
+  // each one the root of a quadtree at most max_depth - min_depth deep;
+  // min_depth <= max_depth <= 24, and min_depth <= 15
+  int min_depth{5};
+  int max_depth{12};
+};
+
+// exit state of a particle, from an ExitMap
+struct MapExit
+{
+  bool right;
+  // meaningful only for particles exiting from the right side
+  double y;
+  double theta;
+};
+
+// tabulated map (y0, theta0) -> (yf, thetaf) of a pair of barriers, over
+// y0 in [-r1, r1] and |theta0| < pi / 2: a cell is split while its sampled
+// points exit from different sides, with different bounce sequences, or are
+// not reproduced by bilinear interpolation within the tolerance. Leaves that
+// still straddle a discontinuity, or are not accurate, at max_depth are left
+// to the exact engine.
+// The file is the in-memory layout, so it is memory mapped as it is.
+class ExitMap
+{
+ public:
+  struct Node
+  {
+    // children at first_child + 2 * (upper theta half) + (upper y half), 0
+    // for a leaf
+    std::uint32_t first_child;
+    std::uint32_t leaf;
+  };
+
+  enum class Kind : std::uint32_t
+  {
+    right,
+    left,
+    mixed
+  };
+
+  // values at the corners (y_lo, theta_lo), (y_hi, theta_lo), (y_lo, theta_hi),
+  // (y_hi, theta_hi)
+  struct Leaf
+  {
+    std::array<double, 4> yf;
+    std::array<double, 4> thetaf;
+    Kind kind;
+    std::uint32_t padding;
+  };
+
+  struct Header
+  {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    // the grid of the roots is top x top
+    std::uint32_t top;
+    std::uint64_t n_nodes;
+    std::uint64_t n_leaves;
+    double y_lo;
+    double y_hi;
+    double theta_lo;
+    double theta_hi;
+    // geometry the map was built for
+    double l;
+    std::array<double, Globals::MAX_DEGREE + 1> up;
+    std::array<double, Globals::MAX_DEGREE + 1> down;
+  };
+
+ private:
+  struct Unmap
+  {
+    std::size_t size;
+    void operator()(void* p) const;
+  };
+
+  Header header_;
+  // storage of a built map, or mapping of a file
+  std::vector<Node> owned_nodes_;
+  std::vector<Leaf> owned_leaves_;
+  std::unique_ptr<void, Unmap> mapping_;
+  std::span<Node const> nodes_;
+  std::span<Leaf const> leaves_;
+
+  ExitMap() = default;
+
+ public:
+  // simulates the particles of the sampled points with
+  // simulate_single_particle, cells of the top grid in parallel
+  static ExitMap build(Barrier const& barrier_up, Barrier const& barrier_down,
+                       ExitMapOptions const& options, ThreadPool& pool);
+  // memory maps a file written by save; throws if it is not a valid map
+  static ExitMap map(std::string const& path);
+
+  // throws on write errors
+  void save(std::string const& path) const;
+
+  // true if the map was built for this pair of barriers
+  bool matches(Barrier const& barrier_up, Barrier const& barrier_down) const;
+
+  std::size_t n_leaves() const;
+
+  // interpolated exit state; nullopt outside the domain and in the leaves
+  // straddling a discontinuity, where the exact engine has to be used
+  std::optional<MapExit> lookup(double y0, double theta0) const;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef FIXED_VECTOR_HPP
+#define FIXED_VECTOR_HPP
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+
+// vector-like container with inline storage for at most N elements, it never
+// allocates: used for the small sequences (coefficients, roots, collisions)
+// created at every bounce
+template<typename T, std::size_t N>
+class FixedVector
+{
+  std::array<T, N> data_{};
+  std::size_t size_{0};
+
+ public:
+  FixedVector() = default;
+  FixedVector(std::size_t size, T const& value)
+      : size_{size}
+  {
+    assert(size <= N);
+    for (std::size_t i{0}; i != size; ++i) {
+      data_[i] = value;
+    }
+  }
+
+  void push_back(T const& value)
+  {
+    assert(size_ < N);
+    data_[size_++] = value;
+  }
+  void clear()
+  {
+    size_ = 0;
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+  static constexpr std::size_t capacity()
+  {
+    return N;
+  }
+
+  T& operator[](std::size_t i)
+  {
+    assert(i < size_);
+    return data_[i];
+  }
+  T const& operator[](std::size_t i) const
+  {
+    assert(i < size_);
+    return data_[i];
+  }
+
+  T* begin()
+  {
+    return data_.data();
+  }
+  T* end()
+  {
+    return data_.data() + size_;
+  }
+  T const* begin() const
+  {
+    return data_.data();
+  }
+  T const* end() const
+  {
+    return data_.data() + size_;
+  }
+};
+
+#endif
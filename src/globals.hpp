@@ -1,9 +1,53 @@
 #ifndef GLOBALS_HPP
 #define GLOBALS_HPP
 
+#include <cstddef>
+#include <limits>
+
 namespace Globals {
 constexpr double EPS{1e-8};
 constexpr int MAX_ITERATIONS{20};
+// highest supported degree of a barrier polynomial
+constexpr std::size_t MAX_DEGREE{8};
+
+// machine epsilon of T relative to the one of double
+template<typename T>
+constexpr double PRECISION_RATIO{
+    static_cast<double>(std::numeric_limits<T>::epsilon())
+    / std::numeric_limits<double>::epsilon()};
+
+namespace detail {
+constexpr double sqrt(double x)
+{
+  double r{x > 1. ? x : 1.};
+  for (int i{0}; i != 100; ++i) {
+    r = 0.5 * (r + x / r);
+  }
+  return r;
+}
+} // namespace detail
+
+// a tolerance tol of the double engine scaled to the precision of T: with
+// the machine epsilon for the ones close to it, e.g. the 1e-15 of a Newton
+// step, with its square root for the ones that are not
+template<typename T>
+constexpr T scaled_tolerance(double tol)
+{
+  return static_cast<T>(tol * PRECISION_RATIO<T>);
+}
+template<typename T>
+constexpr T sqrt_scaled_tolerance(double tol)
+{
+  return static_cast<T>(PRECISION_RATIO<T> == 1.
+                            ? tol
+                            : tol * detail::sqrt(PRECISION_RATIO<T>));
+}
+
+// EPS, about the square root of the machine epsilon of double, for T: EPS
+// itself for double, about 2e-4 for float. It is a tolerance of distances and
+// discriminants; a leading coefficient is dropped below EPS in every type
+template<typename T>
+constexpr T EPS_OF{sqrt_scaled_tolerance<T>(EPS)};
 } // namespace Globals
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,136 @@
+#include "job.hpp"
+#include <fstream>
+#include <sstream>
+
+Job::Job(std::vector<std::string> const& tokens)
+{
+  for (auto const& token : tokens) {
+    auto const eq = token.find('=');
+    if (eq == std::string::npos || eq == 0) {
+      throw std::invalid_argument{"expected key=value, found " + token};
+    }
+    if (!values_.emplace(token.substr(0, eq), token.substr(eq + 1)).second) {
+      throw std::invalid_argument{"repeated parameter " + token.substr(0, eq)};
+    }
+  }
+}
+
+std::string const& Job::value(std::string const& key) const
+{
+  auto const it = values_.find(key);
+  if (it == values_.end()) {
+    throw std::invalid_argument{"missing parameter " + key};
+  }
+  used_.insert(key);
+  return it->second;
+}
+
+bool Job::has(std::string const& key) const
+{
+  return values_.contains(key);
+}
+
+std::vector<double> Job::get_list(std::string const& key) const
+{
+  std::string const& v{value(key)};
+  std::vector<double> result;
+  char const* first{v.data()};
+  char const* const last{v.data() + v.size()};
+  for (;;) {
+    double x{0.};
+    auto const [end, ec] = std::from_chars(first, last, x);
+    if (ec != std::errc{} || (end != last && *end != ',')) {
+      throw std::invalid_argument{"invalid value of " + key + ": " + v};
+    }
+    result.push_back(x);
+    if (end == last) {
+      return result;
+    }
+    first = end + 1;
+  }
+}
+
+std::vector<double> Job::get_grid(std::string const& key) const
+{
+  std::string const& v{value(key)};
+  auto const colon1 = v.find(':');
+  if (colon1 == std::string::npos) {
+    return get_list(key);
+  }
+  auto const colon2 = v.find(':', colon1 + 1);
+  if (colon2 == std::string::npos) {
+    throw std::invalid_argument{"invalid grid " + key + ": " + v};
+  }
+
+  Job const range{{"start=" + v.substr(0, colon1),
+                   "stop=" + v.substr(colon1 + 1, colon2 - colon1 - 1),
+                   "count=" + v.substr(colon2 + 1)}};
+  double const start{range.get<double>("start")};
+  double const stop{range.get<double>("stop")};
+  std::size_t const count{range.get<std::size_t>("count")};
+  if (count == 0) {
+    throw std::invalid_argument{"empty grid " + key + ": " + v};
+  }
+
+  std::vector<double> result(count, start);
+  for (std::size_t i{1}; i < count; ++i) {
+    result[i] = start
+              + (stop - start) * static_cast<double>(i)
+                    / static_cast<double>(count - 1);
+  }
+  return result;
+}
+
+void Job::check_unused() const
+{
+  std::string unused;
+  for (auto const& [key, v] : values_) {
+    if (!used_.contains(key)) {
+      unused += ' ' + key;
+    }
+  }
+  if (!unused.empty()) {
+    throw std::invalid_argument{"unknown parameters:" + unused};
+  }
+}
+
+std::vector<Job> read_jobs(std::istream& in)
+{
+  std::vector<Job> jobs;
+  for (std::string line; std::getline(in, line);) {
+    std::istringstream tokens_in{line};
+    std::vector<std::string> tokens;
+    for (std::string token; tokens_in >> token;) {
+      tokens.push_back(token);
+    }
+    if (!tokens.empty() && tokens.front()[0] != '#') {
+      jobs.emplace_back(tokens);
+    }
+  }
+  return jobs;
+}
+
+std::vector<Job> jobs_from_args(int argc, char const* const* argv)
+{
+  std::vector<std::string> args(argv + 1, argv + argc);
+  if (!args.empty() && args[0] == "--jobs") {
+    if (args.size() != 2) {
+      throw std::invalid_argument{"usage: --jobs <job file>"};
+    }
+    std::ifstream file{args[1]};
+    if (!file) {
+      throw std::runtime_error{"Cannot open " + args[1]};
+    }
+    // an empty file must not fall back to an interactive run, which would
+    // wait for the input of an automated one
+    std::vector<Job> jobs{read_jobs(file)};
+    if (jobs.empty()) {
+      throw std::runtime_error{"No jobs in " + args[1]};
+    }
+    return jobs;
+  }
+  if (args.empty()) {
+    return {};
+  }
+  return {Job{args}};
+}
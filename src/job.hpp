@@ -0,0 +1,75 @@
+#ifndef JOB_HPP
+#define JOB_HPP
+
+#include <charconv>
+#include <cstddef>
+#include <istream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+// parameters of a non-interactive run, given as key=value pairs on the command
+// line or on a line of a job file
+class Job
+{
+  std::map<std::string, std::string> values_;
+  // keys read by get, to report the unknown ones
+  mutable std::set<std::string> used_;
+
+  std::string const& value(std::string const& key) const;
+
+ public:
+  // throws if a token is not key=value or a key is repeated
+  explicit Job(std::vector<std::string> const& tokens);
+
+  bool has(std::string const& key) const;
+
+  // throws if the key is missing or its value is not a T
+  template<typename T>
+  T get(std::string const& key) const
+  {
+    std::string const& v{value(key)};
+    if constexpr (std::is_same_v<T, std::string>) {
+      return v;
+    } else {
+      T result{};
+      auto const [end, ec] =
+          std::from_chars(v.data(), v.data() + v.size(), result);
+      if (ec != std::errc{} || end != v.data() + v.size()) {
+        throw std::invalid_argument{"invalid value of " + key + ": " + v};
+      }
+      return result;
+    }
+  }
+
+  template<typename T>
+  T get(std::string const& key, T const& fallback) const
+  {
+    return has(key) ? get<T>(key) : fallback;
+  }
+
+  // comma separated values, e.g. pol=1.5,0,-0.1
+  std::vector<double> get_list(std::string const& key) const;
+
+  // grid of values of a sweep: a single value, comma separated values, or
+  // start:stop:count for count values evenly spaced in [start, stop]
+  std::vector<double> get_grid(std::string const& key) const;
+
+  // throws if some keys have never been read, e.g. because of a typo
+  void check_unused() const;
+};
+
+// one job per line, tokens separated by spaces; blank lines and lines
+// starting with # are skipped
+std::vector<Job> read_jobs(std::istream& in);
+
+// "--jobs <file>" reads the jobs of a file, and throws if it has none;
+// otherwise the arguments are the tokens of a single job. No arguments give
+// no jobs, i.e. an interactive run
+std::vector<Job> jobs_from_args(int argc, char const* const* argv);
+
+#endif
@@ -1,46 +1,56 @@
 #include "kinematics.hpp"
+#include "counters.hpp"
 #include "globals.hpp"
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <optional>
 
-Result::Result(Vec2 const& p, double theta)
+template<typename T>
+BasicResult<T>::BasicResult(BasicVec2<T> const& p, T theta)
     : p_{p}
     , theta_{theta}
 {}
 
-Result Trajectory::result() const
+template<typename T>
+BasicResult<T> BasicTrajectory<T>::result() const
 {
-  return Result(p_, std::atan2(v_.y_, v_.x_));
+  return BasicResult<T>(p_, std::atan2(v_.y_, v_.x_));
 }
 
-void Trajectory::exit(double x)
+template<typename T>
+void BasicTrajectory<T>::exit(T x)
 {
-  double time = (x - p_.x_) / v_.x_;
+  T time = (x - p_.x_) / v_.x_;
 
   p_.x_ = x;
   p_.y_ += time * v_.y_;
 }
 
-bool Result::operator==(Result b) const
+template<typename T>
+bool BasicResult<T>::operator==(BasicResult b) const
 {
   return (this->p_ == b.p_ && this->theta_ == b.theta_);
 }
 
-double Result::get_x() const
+template<typename T>
+T BasicResult<T>::get_x() const
 {
   return p_.x_;
 }
-double Result::get_y() const
+template<typename T>
+T BasicResult<T>::get_y() const
 {
   return p_.y_;
 }
-double Result::get_theta() const
+template<typename T>
+T BasicResult<T>::get_theta() const
 {
   return theta_;
 }
 
-std::ostream& operator<<(std::ostream& os, Result const& res)
+template<typename T>
+std::ostream& operator<<(std::ostream& os, BasicResult<T> const& res)
 {
   if (res.get_x() == -1) {
     std::cout << "Ball goes backwards and exits system from origin";
@@ -51,108 +61,388 @@ std::ostream& operator<<(std::ostream& os, Result const& res)
   }
 }
 
-Trajectory::Trajectory(Vec2 const& p, double theta)
+template<typename T>
+BasicTrajectory<T>::BasicTrajectory(BasicVec2<T> const& p, T theta)
     : p_{p}
-    , v_{cos(theta), sin(theta)}
+    , v_{std::cos(theta), std::sin(theta)}
 {}
 
-Barrier::Barrier(Pol const& pol, double x_max)
+namespace {
+template<typename T>
+typename BasicBarrier<T>::Shape make_shape(BasicPol<T> const& pol)
+{
+  switch (pol.deg()) {
+  case 1:
+    return FixedPol<1, T>{pol};
+  case 2:
+    return FixedPol<2, T>{pol};
+  default:
+    return pol;
+  }
+}
+} // namespace
+
+template<typename T>
+BasicBarrier<T>::BasicBarrier(BasicPol<T> const& pol, T x_max)
     : max_{x_max, pol(x_max)}
     , pol_{pol}
+    , shape_{make_shape(pol)}
 {
-  assert(x_max > 0.);
+  assert(x_max > 0);
+  set_segments();
 }
 
-Barrier::Barrier(double l, double r1, double r2)
+template<typename T>
+BasicBarrier<T>::BasicBarrier(T l, T r1, T r2)
     : max_{l, r2}
-    , pol_{std::vector<double>{r1, (r2 - r1) / l}}
+    , pol_{r1, (r2 - r1) / l}
+    , shape_{make_shape(pol_)}
 {
-  assert(l > 0.);
+  assert(l > 0);
+  set_segments();
 }
 
-double Barrier::max() const
+template<typename T>
+void BasicBarrier<T>::set_segments()
+{
+  // zeros of the first and second derivatives in (0, max)
+  std::array<T, Globals::MAX_DEGREE + 1> der{};
+  std::array<T, Globals::MAX_DEGREE + 1> der2{};
+  auto const coeff = pol_.coeff();
+  for (std::size_t i{1}; i < coeff.size(); ++i) {
+    der[i - 1] = static_cast<T>(i) * coeff[i];
+  }
+  for (std::size_t i{1}; i < coeff.size(); ++i) {
+    der2[i - 1] = static_cast<T>(i) * der[i];
+  }
+  std::array<T, 2 * Globals::MAX_DEGREE + 1> x{};
+  std::size_t n{0};
+  x[n++] = 0;
+  for (auto const& d : {der, der2}) {
+    for (T root : solve_sturm<T>(d, 0, max_.x_)) {
+      if (root < max_.x_) {
+        x[n++] = root;
+      }
+    }
+  }
+  std::sort(x.begin(), x.begin() + n);
+  x[n++] = max_.x_;
+
+  y_min_ = y_max_ = pol_(0);
+  for (std::size_t i{0}; i + 1 != n; ++i) {
+    if (x[i + 1] == x[i]) {
+      continue;
+    }
+    Segment const s{{x[i], pol_(x[i])},
+                    {x[i + 1], pol_(x[i + 1])},
+                    pol_.der(x[i]),
+                    pol_.der(x[i + 1])};
+    y_min_ = std::min({y_min_, s.lo.y_, s.hi.y_});
+    y_max_ = std::max({y_max_, s.lo.y_, s.hi.y_});
+    segments_.push_back(s);
+  }
+}
+
+template<typename T>
+T BasicBarrier<T>::max() const
 {
   return max_.x_;
 }
 
-Pol Barrier::pol() const
+template<typename T>
+BasicPol<T> const& BasicBarrier<T>::pol() const
 {
   return pol_;
 }
 
-std::vector<Collision> intersect(Trajectory const& t, Barrier const* b)
+template<typename T>
+T BasicBarrier<T>::der(T x) const
 {
-  if (std::abs(t.v_.x_) < Globals::EPS) { /* handle vertical trajectory */
-    if (t.p_.y_ == b->pol()(t.p_.x_)) {
-      return {};
-    } else {
-      return {{{t.p_.x_, b->pol()(t.p_.x_)}, b}};
+  return visit([x](auto const& pol) { return pol.der(x); });
+}
+
+template<typename T>
+typename BasicBarrier<T>::Segments const& BasicBarrier<T>::segments() const
+{
+  return segments_;
+}
+
+template<typename T>
+template<std::size_t N>
+std::array<bool, N>
+BasicBarrier<T>::slab_test(std::array<FixedPol<1, T>, N> const& lines,
+                           T x_min, T x_max) const
+{
+  // bounds are widened by EPS, so that grazing trajectories, which eq_solve
+  // may report as tangent, are not skipped
+  T const eps{Globals::EPS_OF<T>};
+  std::array<bool, N> res{};
+  x_min = std::max(x_min, T{0});
+  x_max = std::min(x_max, max_.x_);
+  if (x_min > x_max) {
+    return res;
+  }
+  // lines still to be tested
+  std::array<bool, N> open{};
+  bool any_open{false};
+  for (std::size_t k{0}; k != N; ++k) {
+    T const l_min{std::min(lines[k](x_min), lines[k](x_max))};
+    T const l_max{std::max(lines[k](x_min), lines[k](x_max))};
+    open[k]  = !(l_max < y_min_ - eps || l_min > y_max_ + eps);
+    any_open = any_open || open[k];
+  }
+
+  // the bounds of the barrier are shared by the lines
+  for (auto const& s : segments_) {
+    if (!any_open) {
+      break;
+    }
+    T const a{std::max(x_min, s.lo.x_)};
+    T const b{std::min(x_max, s.hi.x_)};
+    if (a > b) {
+      continue;
+    }
+    // barrier and slope at the ends of [a, b]
+    T const ya{a == s.lo.x_ ? s.lo.y_ : pol_(a)};
+    T const yb{b == s.hi.x_ ? s.hi.y_ : pol_(b)};
+    T const da{a == s.lo.x_ ? s.der_lo : pol_.der(a)};
+    T const db{b == s.hi.x_ ? s.der_hi : pol_.der(b)};
+    any_open = false;
+    for (std::size_t k{0}; k != N; ++k) {
+      if (!open[k]) {
+        continue;
+      }
+      T const la{lines[k](a)};
+      T const lb{lines[k](b)};
+      T const m{lines[k].coeff()[1]};
+      // line - barrier is strictly monotonic if m is not a slope of the
+      // barrier in [a, b], then it has no zero if its sign does not change
+      bool const disjoint{std::max(la, lb) < std::min(ya, yb) - eps
+                          || std::min(la, lb) > std::max(ya, yb) + eps};
+      bool const monotonic{m < std::min(da, db) - eps
+                           || m > std::max(da, db) + eps};
+      if (!disjoint && !(monotonic && (la - ya) * (lb - yb) > 0)) {
+        res[k]  = true;
+        open[k] = false;
+      }
+      any_open = any_open || open[k];
     }
   }
+  return res;
+}
 
-  double t_m = t.v_.y_ / t.v_.x_;
-  Pol t_pol{{t.p_.y_ - t_m * t.p_.x_, t_m}};
+template<typename T>
+bool BasicBarrier<T>::may_intersect(FixedPol<1, T> const& line, T x_min,
+                                    T x_max) const
+{
+  return slab_test(std::array{line}, x_min, x_max)[0];
+}
+
+template<typename T>
+std::array<bool, 2>
+BasicBarrier<T>::may_intersect_mirrored(FixedPol<1, T> const& line, T x_min,
+                                        T x_max) const
+{
+  auto const& c = line.coeff();
+  return slab_test(std::array{line, FixedPol<1, T>{-c[0], -c[1]}}, x_min,
+                   x_max);
+}
+
+template<typename T>
+bool BasicBarrier<T>::mirrors(BasicBarrier const& other) const
+{
+  auto const c       = pol_.coeff();
+  auto const other_c = other.pol_.coeff();
+  return max_.x_ == other.max_.x_ && c.size() == other_c.size()
+      && std::equal(c.begin(), c.end(), other_c.begin(),
+                    [](T a, T b) { return a == -b; });
+}
 
-  std::vector<double> sol_x = eq_solve(t_pol, b->pol());
+namespace {
+// y of the collision at x of the line with the barrier b. The line amplifies
+// the error of x by its slope, that of a steep trajectory can be in the
+// thousands: in types less precise than double the point is taken on the
+// barrier, whose slope is small
+template<typename T>
+T collision_y(FixedPol<1, T> const& line, BasicBarrier<T> const& b, T x)
+{
+  if constexpr (Globals::PRECISION_RATIO<T> > 1.) {
+    return b.pol()(x);
+  } else {
+    return line(x);
+  }
+}
 
-  // filter solutions based on particle direction
+// x is ahead of the particle, in (0, max]
+template<typename T>
+bool ahead(BasicTrajectory<T> const& t, T x, T max)
+{
+  T const eps{Globals::EPS_OF<T>};
   if (t.v_.x_ > 0) {
-    std::erase_if(sol_x, [&](double x) {
-      return x - t.p_.x_ <= Globals::EPS || x > b->max();
-    });
+    return !(x - t.p_.x_ <= eps || x > max);
   } else if (t.v_.x_ < 0) {
-    std::erase_if(sol_x, [&](double x) {
-      return x - t.p_.x_ >= -Globals::EPS || x <= 0.;
-    });
+    return !(x - t.p_.x_ >= -eps || x <= 0);
   }
-  std::vector<Collision> sol(sol_x.size(), Collision{});
-  std::transform(sol_x.begin(), sol_x.end(), sol.begin(),
-                 [&](double x) { return Collision{{x, t_pol(x)}, b}; });
+  return true;
+}
+} // namespace
+
+template<typename T>
+BasicCollisions<T> intersect(BasicTrajectory<T> const& t,
+                             BasicBarrier<T> const* b)
+{
+  using Counters::Event;
+  Counters::add(Event::intersections);
+  T const eps{Globals::EPS_OF<T>};
+  BasicCollisions<T> sol;
+
+  if (std::abs(t.v_.x_) < eps) { /* handle vertical trajectory */
+    Counters::add(Event::vertical);
+    // ahead along y, and not the point of the last bounce
+    T const y{b->pol()(t.p_.x_)};
+    if (std::abs(y - t.p_.y_) >= eps && (y > t.p_.y_) == (t.v_.y_ > 0)) {
+      sol.push_back({{t.p_.x_, y}, b});
+    }
+    return sol;
+  }
+
+  T t_m = t.v_.y_ / t.v_.x_;
+  FixedPol<1, T> t_pol{t.p_.y_ - t_m * t.p_.x_, t_m};
+
+  // the closed forms of linear and quadratic barriers cost less than the slab
+  // test
+  if (b->pol().deg() > 2
+      && !b->may_intersect(t_pol, t.v_.x_ > 0 ? t.p_.x_ + eps : T{0},
+                           t.v_.x_ > 0 ? b->max() : t.p_.x_ - eps)) {
+    Counters::add(Event::slab_skips);
+    return sol;
+  }
+  BasicRoots<T> sol_x = b->visit(
+      [&](auto const& pol) { return eq_solve(t_pol, pol, 0, b->max()); });
+
+  // keep solutions based on particle direction
+  for (T x : sol_x) {
+    if (ahead(t, x, b->max())) {
+      sol.push_back({{x, collision_y(t_pol, *b, x)}, b});
+    }
+  }
+  Counters::add(Event::roots_found, sol_x.size());
+  Counters::add(Event::roots_rejected, sol_x.size() - sol.size());
   return sol;
 }
 
-Result simulate_single_particle(Barrier const& barrier_up,
-                                Barrier const& barrier_down, Trajectory t,
-                                std::vector<Vec2>* bounces)
+namespace {
+// nearest collision of t with either barrier
+template<typename T>
+std::optional<BasicCollision<T>>
+nearest(BasicTrajectory<T> const& t, BasicBarrier<T> const& barrier_up,
+        BasicBarrier<T> const& barrier_down)
 {
-  assert(std::abs(t.p_.y_) < barrier_up.pol()(0.));
+  std::optional<BasicCollision<T>> bounce;
+  T bounce_dist2{0};
+  auto const up_int   = intersect(t, &barrier_up);
+  auto const down_int = intersect(t, &barrier_down);
+  for (auto const* collisions : {&up_int, &down_int}) {
+    for (auto const& c : *collisions) {
+      T d2 = c.p_.dist2(t.p_);
+      if (!bounce || d2 < bounce_dist2) {
+        bounce       = c;
+        bounce_dist2 = d2;
+      }
+    }
+  }
+  return bounce;
+}
 
-  std::vector<Collision> collisions;
-  collisions.reserve(4);
+// nearest collision of t, not vertical, with barrier_up or its mirror
+// barrier_down: line(x) = -up(x) is solved as -line(x) = up(x), so both
+// equations share the polynomial of barrier_up and, from degree 3, the bounds
+// of its slab test, and the roots are the ones intersect finds. Up to degree 2
+// the two equations are solved separately: their closed forms cost less than
+// the slab test, and solving them together saved nothing. Along the line the
+// nearest collision is the one with the nearest x.
+template<typename T>
+std::optional<BasicCollision<T>>
+nearest_mirrored(BasicTrajectory<T> const& t,
+                 BasicBarrier<T> const& barrier_up,
+                 BasicBarrier<T> const& barrier_down)
+{
+  T const eps{Globals::EPS_OF<T>};
+  T const t_m{t.v_.y_ / t.v_.x_};
+  FixedPol<1, T> const t_pol{t.p_.y_ - t_m * t.p_.x_, t_m};
+  FixedPol<1, T> const mirror{-t_pol.coeff()[0], -t_m};
+  T const max{barrier_up.max()};
 
-  for (int i{0}; i < Globals::MAX_ITERATIONS; ++i) {
-    if (bounces)
-      bounces->push_back(t.p_);
+  std::array<bool, 2> hit{true, true};
+  if (barrier_up.pol().deg() > 2) {
+    hit = barrier_up.may_intersect_mirrored(
+        t_pol, t.v_.x_ > 0 ? t.p_.x_ + eps : T{0},
+        t.v_.x_ > 0 ? max : t.p_.x_ - eps);
+  }
 
-    collisions.clear();
+  using Counters::Event;
+  Counters::add(Event::intersections, 2);
+  std::optional<BasicCollision<T>> bounce;
+  std::array<BasicBarrier<T> const*, 2> const barriers{&barrier_up,
+                                                       &barrier_down};
+  std::array<FixedPol<1, T> const*, 2> const lines{&t_pol, &mirror};
+  for (std::size_t k{0}; k != 2; ++k) {
+    if (!hit[k]) {
+      Counters::add(Event::slab_skips);
+      continue;
+    }
+    BasicRoots<T> const sol_x{barrier_up.visit([&](auto const& pol) {
+      return eq_solve(*lines[k], pol, 0, max);
+    })};
+    Counters::add(Event::roots_found, sol_x.size());
+    for (T x : sol_x) {
+      if (!ahead(t, x, max)) {
+        Counters::add(Event::roots_rejected);
+      } else if (!bounce
+                 || std::abs(x - t.p_.x_)
+                        < std::abs(bounce->p_.x_ - t.p_.x_)) {
+        bounce = BasicCollision<T>{{x, collision_y(t_pol, *barriers[k], x)},
+                                   barriers[k]};
+      }
+    }
+  }
+  return bounce;
+}
+} // namespace
 
-    auto up_int   = intersect(t, &barrier_up);
-    auto down_int = intersect(t, &barrier_down);
-    collisions.insert(collisions.end(), up_int.begin(), up_int.end());
-    collisions.insert(collisions.end(), down_int.begin(), down_int.end());
+template<typename T>
+BasicResult<T> simulate_single_particle(BasicBarrier<T> const& barrier_up,
+                                        BasicBarrier<T> const& barrier_down,
+                                        BasicTrajectory<T> t,
+                                        std::vector<BasicVec2<T>>* bounces)
+{
+  assert(std::abs(t.p_.y_) < barrier_up.pol()(0));
+  bool const mirrored{barrier_down.mirrors(barrier_up)};
+  Counters::add(Counters::Event::particles);
 
-    if (collisions.size() != 0) { /* choose bounce and update trajectory */
+  for (int i{0}; i < Globals::MAX_ITERATIONS; ++i) {
+    if (bounces)
+      bounces->push_back(t.p_);
 
-      Collision bounce =
-          *std::min_element(collisions.begin(), collisions.end(),
-                            [&](Collision const& lhs, Collision const& rhs) {
-                              return lhs.p_.dist2(t.p_) < rhs.p_.dist2(t.p_);
-                            });
+    // choose the nearest collision with either barrier
+    std::optional<BasicCollision<T>> const bounce{
+        mirrored && std::abs(t.v_.x_) >= Globals::EPS_OF<T>
+            ? nearest_mirrored(t, barrier_up, barrier_down)
+            : nearest(t, barrier_up, barrier_down)};
 
-      t.p_ = bounce.p_;
+    if (bounce) { /* update trajectory */
+      Counters::add(Counters::Event::bounces);
 
-      Vec2 tg = Vec2{1., bounce.b_ptr->pol().der(bounce.p_.x_)};
-      tg      = tg * (1. / tg.norm());
-      Vec2 n  = tg.ortho();
+      t.p_ = bounce->p_;
 
-      auto v_new = n * (-dot(t.v_, n)) + tg * dot(t.v_, tg);
-      t.v_       = v_new;
+      BasicVec2<T> tg{1, bounce->b_ptr->der(bounce->p_.x_)};
+      t.v_ = t.v_.reflect(tg.normalize().ortho());
 
     } else { /* exit right or left */
       if (t.v_.x_ > 0) {
         t.exit(barrier_up.max());
       } else {
-        t.exit(0.);
+        t.exit(0);
       }
       if (bounces)
         bounces->push_back(t.p_);
@@ -161,5 +451,23 @@ Result simulate_single_particle(Barrier const& barrier_up,
     }
   }
 
+  Counters::add(Counters::Event::max_iterations);
   return t.result();
 }
+
+// the engines of every supported scalar type
+#define INSTANTIATE_KINEMATICS(T)                                             \
+  template class BasicResult<T>;                                              \
+  template std::ostream& operator<<(std::ostream&, BasicResult<T> const&);    \
+  template struct BasicTrajectory<T>;                                         \
+  template class BasicBarrier<T>;                                             \
+  template BasicCollisions<T> intersect(BasicTrajectory<T> const&,            \
+                                        BasicBarrier<T> const*);              \
+  template BasicResult<T> simulate_single_particle(                           \
+      BasicBarrier<T> const&, BasicBarrier<T> const&, BasicTrajectory<T>,     \
+      std::vector<BasicVec2<T>>*);
+
+INSTANTIATE_KINEMATICS(float)
+INSTANTIATE_KINEMATICS(double)
+INSTANTIATE_KINEMATICS(long double)
+#undef INSTANTIATE_KINEMATICS
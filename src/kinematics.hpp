@@ -1,65 +1,152 @@
 #ifndef KINEMATICS_HPP
 #define KINEMATICS_HPP
 
+#include "fixed_vector.hpp"
+#include "globals.hpp"
 #include "mathematics.hpp"
+#include <array>
 #include <iostream>
+#include <span>
+#include <utility>
+#include <variant>
 #include <vector>
 
-class Result
+template<typename T>
+class BasicResult
 {
-  Vec2 p_;
-  double theta_;
+  BasicVec2<T> p_;
+  T theta_;
 
  public:
   // see Trajectory.result() instead
-  Result(Vec2 const& p, double theta);
+  BasicResult(BasicVec2<T> const& p, T theta);
 
-  bool operator==(Result b) const;
+  bool operator==(BasicResult b) const;
 
-  double get_x() const;
-  double get_y() const;
-  double get_theta() const;
+  T get_x() const;
+  T get_y() const;
+  T get_theta() const;
 };
-std::ostream& operator<<(std::ostream& os, Result const& res);
+template<typename T>
+std::ostream& operator<<(std::ostream& os, BasicResult<T> const& res);
 
-struct Trajectory
+template<typename T>
+struct BasicTrajectory
 {
-  Vec2 p_;
-  Vec2 v_;
+  BasicVec2<T> p_;
+  BasicVec2<T> v_;
 
-  Trajectory(Vec2 const& p_, double theta);
-  void exit(double x); // check for x=0
+  BasicTrajectory(BasicVec2<T> const& p_, T theta);
+  void exit(T x); // check for x=0
 
-  Result result() const;
+  BasicResult<T> result() const;
 };
 
-class Barrier
+template<typename T>
+class BasicBarrier
 {
-  Vec2 max_;
-  Pol pol_;
+ public:
+  // linear and quadratic barriers are stored as FixedPol, so that their
+  // evaluation and intersection compile to straight-line code
+  using Shape = std::variant<FixedPol<1, T>, FixedPol<2, T>, BasicPol<T>>;
+
+  // piece of the barrier between consecutive zeros, in (0, max), of its first
+  // and second derivatives: the barrier and its slope are monotonic on it, so
+  // their bounds are the values at the ends
+  struct Segment
+  {
+    BasicVec2<T> lo;
+    BasicVec2<T> hi;
+    T der_lo;
+    T der_hi;
+  };
+  using Segments = FixedVector<Segment, 2 * Globals::MAX_DEGREE>;
+
+ private:
+  BasicVec2<T> max_;
+  BasicPol<T> pol_;
+  Shape shape_;
+  Segments segments_;
+  // bounds of the barrier in [0, max]
+  T y_min_;
+  T y_max_;
+
+  void set_segments();
+  template<std::size_t N>
+  std::array<bool, N> slab_test(std::array<FixedPol<1, T>, N> const& lines,
+                                T x_min, T x_max) const;
 
  public:
   // generic constructor
-  Barrier(Pol const& p = {{1, 0}}, double x_max = 1);
+  BasicBarrier(BasicPol<T> const& p = {{1, 0}}, T x_max = 1);
   // constructor for linear barrier
-  Barrier(double l, double r1, double r2);
+  BasicBarrier(T l, T r1, T r2);
+
+  T max() const;
+  BasicPol<T> const& pol() const;
+  T der(T x) const;
+  Segments const& segments() const;
 
-  double max() const;
-  Pol pol() const;
+  // slab test: false if line cannot cross the barrier in [x_min, x_max],
+  // checked on the bounds of the segments; true does not imply a crossing
+  bool may_intersect(FixedPol<1, T> const& line, T x_min, T x_max) const;
+  // may_intersect of line with this barrier and with its mirror, sharing the
+  // bounds of the segments
+  std::array<bool, 2> may_intersect_mirrored(FixedPol<1, T> const& line,
+                                             T x_min, T x_max) const;
+  // true if this barrier is the mirror image of other across y = 0
+  bool mirrors(BasicBarrier const& other) const;
+
+  // calls f with the barrier polynomial, as its most specialised type
+  template<typename F>
+  decltype(auto) visit(F&& f) const
+  {
+    return std::visit(std::forward<F>(f), shape_);
+  }
 };
 
-struct Collision
+template<typename T>
+struct BasicCollision
 {
-  Vec2 p_;
-  Barrier const* b_ptr;
+  BasicVec2<T> p_;
+  BasicBarrier<T> const* b_ptr;
 };
 
+template<typename T>
+using BasicCollisions = FixedVector<BasicCollision<T>, Globals::MAX_DEGREE>;
+
 // return all possible collisions (going the right way, in barrier bounds,
 // different from current trajectory point)
-std::vector<Collision> intersect(Trajectory const& t, Barrier const* b);
+template<typename T>
+BasicCollisions<T> intersect(BasicTrajectory<T> const& t,
+                             BasicBarrier<T> const* b);
+
+// does not allocate, unless bounces are recorded
+template<typename T>
+BasicResult<T>
+simulate_single_particle(BasicBarrier<T> const& barrier_up,
+                         BasicBarrier<T> const& barrier_down,
+                         BasicTrajectory<T> t,
+                         std::vector<BasicVec2<T>>* bounces = nullptr);
+
+// the double engine, used by the rest of the program; the float and long
+// double ones are instantiated too, to validate it and to store less, not to
+// run faster (see mathematics.hpp), and tolerances such as Globals::EPS
+// follow the precision of T (Globals::EPS_OF)
+using Result     = BasicResult<double>;
+using Trajectory = BasicTrajectory<double>;
+using Barrier    = BasicBarrier<double>;
+using Collision  = BasicCollision<double>;
+using Collisions = BasicCollisions<double>;
 
-Result simulate_single_particle(Barrier const& barrier_up,
-                                Barrier const& barrier_down, Trajectory t,
-                                std::vector<Vec2>* bounces = nullptr);
+// simulates the particles starting from (0, y0[i]) with angle theta0[i], and
+// writes their final state in x, y and theta: same results as
+// simulate_single_particle, but the bounce loop runs on blocks of particles
+// stored as structure of arrays, so that it can be vectorised. Barriers of
+// degree higher than 2 fall back to simulate_single_particle.
+void simulate_batch(Barrier const& barrier_up, Barrier const& barrier_down,
+                    std::span<double const> y0,
+                    std::span<double const> theta0, std::span<double> x,
+                    std::span<double> y, std::span<double> theta);
 
 #endif
\ No newline at end of file
@@ -1,11 +1,21 @@
+#include "counters.hpp"
+#include "exit_map.hpp"
+#include "globals.hpp"
 #include "graphics.hpp"
+#include "job.hpp"
 #include "kinematics.hpp"
+#include "montecarlo.hpp"
 #include "statistics.hpp"
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
 #include <iostream>
 #include <limits>
-#include <random>
+#include <string>
+#include <vector>
 
 template<typename T>
 void set_from_user_input(T& var, const std::string& var_name)
@@ -18,8 +28,227 @@ void set_from_user_input(T& var, const std::string& var_name)
   std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
 
-int main()
+namespace {
+
+// grid of values of a parameter of a sweep
+struct Axis
+{
+  std::string key;
+  std::vector<double> values;
+};
+
+// non-interactive run: the barriers are given by pol=a_0,a_1,..., by a, b and
+// c of a * x^2 + b * x + c, or, for linear barriers, by r1 and r2. l, a, b,
+// c, r1 and r2 accept a grid of values (Job::get_grid): every combination is a
+// point of a sweep, simulated with the same initial conditions
+// (simulate_sweep), which are pseudo-random or, with sampling=sobol,
+// quasi-random. Results are printed as key=value pairs, one line per point.
+void run_job(Job const& job, std::size_t index, ThreadPool& pool)
+{
+  std::vector<Axis> axes{{"l", job.get_grid("l")}};
+  std::vector<double> pol_coeff;
+  if (job.has("pol")) {
+    pol_coeff = job.get_list("pol");
+  } else if (job.has("a")) {
+    for (char const* key : {"a", "b", "c"}) {
+      axes.push_back({key, job.get_grid(key)});
+    }
+  } else {
+    for (char const* key : {"r1", "r2"}) {
+      axes.push_back({key, job.get_grid(key)});
+    }
+  }
+
+  // the last axis changes fastest
+  std::size_t n_points{1};
+  for (auto const& axis : axes) {
+    n_points *= axis.values.size();
+  }
+  std::vector<std::vector<double>> values(n_points);
+  std::vector<Geometry> points;
+  points.reserve(n_points);
+  for (std::size_t k{0}; k != n_points; ++k) {
+    std::vector<double>& v = values[k];
+    v.resize(axes.size());
+    for (std::size_t i{axes.size()}, rest{k}; i-- > 0;) {
+      v[i] = axes[i].values[rest % axes[i].values.size()];
+      rest /= axes[i].values.size();
+    }
+
+    double const l{v[0]};
+    if (!pol_coeff.empty()) {
+      Pol p{pol_coeff};
+      points.push_back({Barrier{p, l}, Barrier{-p, l}});
+    } else if (axes.size() == 4) {
+      Pol p{{v[3], v[2], v[1]}};
+      points.push_back({Barrier{p, l}, Barrier{-p, l}});
+    } else {
+      points.push_back({Barrier{l, v[1], v[2]}, Barrier{l, -v[1], -v[2]}});
+    }
+  }
+
+  // with mean_error or std_dev_error the particles are simulated until the
+  // standard errors are below them (simulate_until), n being the maximum
+  bool const sequential{job.has("mean_error") || job.has("std_dev_error")};
+  std::size_t const n_sim{
+      sequential ? job.get("n", StoppingRule{}.max_particles)
+                 : job.get<std::size_t>("n")};
+  if (n_sim == 1 && !sequential) {
+    if (n_points != 1) {
+      throw(std::runtime_error("a single particle cannot be swept"));
+    }
+    Barrier const& barrier_up   = points[0].barrier_up;
+    Barrier const& barrier_down = points[0].barrier_down;
+    double const y0{job.get<double>("y0")};
+    double const theta0{job.get<double>("theta0")};
+    job.check_unused();
+    if (y0 >= barrier_up.pol()(0.) || y0 <= barrier_down.pol()(0.)) {
+      throw(std::runtime_error("y0 out of bounds, cannot simulate trajectory"));
+    }
+    Result res = simulate_single_particle(barrier_up, barrier_down,
+                                          Trajectory{{0., y0}, theta0});
+    std::cout << "job=" << index << " x=" << res.get_x()
+              << " y=" << res.get_y() << " theta=" << res.get_theta() << '\n';
+    return;
+  }
+
+  Beam const beam{job.get("mu_y", 0.), job.get("sigma_y", 1.),
+                  job.get("mu_theta", 0.), job.get("sigma_theta", 3.)};
+  std::uint64_t const seed{job.get<std::uint64_t>("seed", 0)};
+  std::string const sampling{
+      job.get<std::string>("sampling", "pseudo_random")};
+  if (sampling != "pseudo_random" && sampling != "sobol") {
+    throw(std::runtime_error("invalid sampling"));
+  }
+
+  auto print = [&](std::size_t k, MonteCarloResult const& result) {
+    auto const stats_y     = result.y.statistics();
+    auto const stats_theta = result.theta.statistics();
+    std::cout << "job=" << index;
+    if (n_points > 1) {
+      std::cout << " point=" << k;
+      for (std::size_t i{0}; i != axes.size(); ++i) {
+        std::cout << ' ' << axes[i].key << '=' << values[k][i];
+      }
+    }
+    std::cout << " n_generated=" << result.n_generated
+              << " n_exited=" << result.theta.size()
+              << " y_mean=" << stats_y.mean << " y_std_dev=" << stats_y.std_dev
+              << " y_skewness=" << stats_y.skewness
+              << " y_kurtosis=" << stats_y.kurtosis
+              << " theta_mean=" << stats_theta.mean
+              << " theta_std_dev=" << stats_theta.std_dev
+              << " theta_skewness=" << stats_theta.skewness
+              << " theta_kurtosis=" << stats_theta.kurtosis;
+  };
+
+  if (sequential) {
+    StoppingRule rule;
+    rule.mean_error    = job.get("mean_error", 0.);
+    rule.std_dev_error = job.get("std_dev_error", 0.);
+    rule.batch         = job.get("batch", rule.batch);
+    rule.max_particles = n_sim;
+    job.check_unused();
+    if (n_points != 1 || sampling != "pseudo_random") {
+      throw(std::runtime_error(
+          "the stopping rule needs a single point and pseudo-random sampling"));
+    }
+
+    SequentialResult const run{simulate_until(points[0].barrier_up,
+                                              points[0].barrier_down, beam,
+                                              rule, seed, pool)};
+    print(0, run.result);
+    std::cout << " y_mean_error=" << run.result.y.mean_error()
+              << " y_std_dev_error=" << run.result.y.std_dev_error()
+              << " theta_mean_error=" << run.result.theta.mean_error()
+              << " theta_std_dev_error=" << run.result.theta.std_dev_error()
+              << " converged=" << run.converged << " seconds=" << run.seconds
+              << '\n';
+    return;
+  }
+
+  // with exit_map=<file> the particles are looked up in the exit map of the
+  // geometry, built and saved there if the file does not exist; its accuracy
+  // is checked against the exact engine on map_check particles
+  if (job.has("exit_map")) {
+    std::string const path{job.get<std::string>("exit_map")};
+    ExitMapOptions options;
+    options.tolerance = job.get("map_tolerance", options.tolerance);
+    options.min_depth = job.get("map_min_depth", options.min_depth);
+    options.max_depth = job.get("map_max_depth", options.max_depth);
+    std::size_t const n_check{job.get("map_check", std::size_t{1} << 16)};
+    job.check_unused();
+    if (n_points != 1) {
+      throw(std::runtime_error("the exit map needs a single point"));
+    }
+    Barrier const& barrier_up   = points[0].barrier_up;
+    Barrier const& barrier_down = points[0].barrier_down;
+
+    bool const built{!std::filesystem::exists(path)};
+    if (built) {
+      ExitMap::build(barrier_up, barrier_down, options, pool).save(path);
+    }
+    ExitMap const map{ExitMap::map(path)};
+    print(0, simulate_n_particles(
+                 map, barrier_up, barrier_down, beam, n_sim, seed, pool,
+                 sampling == "sobol" ? Sampling::sobol
+                                     : Sampling::pseudo_random));
+    std::cout << " map_built=" << built << " map_leaves=" << map.n_leaves();
+    if (n_check != 0) {
+      ExitMapAccuracy const acc{exit_map_accuracy(
+          map, barrier_up, barrier_down, beam, n_check, seed, pool)};
+      std::cout << " map_checked=" << acc.n << " map_served=" << acc.served
+                << " map_misclassified=" << acc.misclassified
+                << " map_y_max_error=" << acc.y_max_error
+                << " map_y_rms_error=" << acc.y_rms_error
+                << " map_theta_max_error=" << acc.theta_max_error
+                << " map_theta_rms_error=" << acc.theta_rms_error;
+    }
+    std::cout << '\n';
+    return;
+  }
+  job.check_unused();
+
+  std::vector<MonteCarloResult> const results{simulate_sweep(
+      points, beam, n_sim, seed, pool,
+      sampling == "sobol" ? Sampling::sobol : Sampling::pseudo_random)};
+  for (std::size_t k{0}; k != n_points; ++k) {
+    print(k, results[k]);
+    std::cout << '\n';
+  }
+}
+
+} // namespace
+
+// without arguments every parameter is asked interactively, otherwise the
+// arguments are the key=value parameters of a job, or "--jobs <file>" runs
+// every job of a file, one per line, in this process and with one ThreadPool
+int main(int argc, char* argv[])
 {
+  std::vector<Job> const jobs{jobs_from_args(argc, argv)};
+  if (!jobs.empty()) {
+    ThreadPool pool;
+    for (std::size_t i{0}; i != jobs.size(); ++i) {
+      try {
+        Counters::reset();
+        auto const start = std::chrono::steady_clock::now();
+        run_job(jobs[i], i, pool);
+        if constexpr (Counters::ENABLED) {
+          std::cout << "job=" << i << ' ';
+          Counters::report(std::cout,
+                           std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count());
+          std::cout << '\n';
+        }
+      } catch (std::exception const& e) {
+        std::cerr << "job " << i << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+      }
+    }
+    return EXIT_SUCCESS;
+  }
+
   Barrier barrier_up;
   Barrier barrier_down;
 
@@ -28,7 +257,8 @@ int main()
                              ">1 with just statistics)");
 
   int deg{0};
-  set_from_user_input(deg, "barrier equation degree [1,2]");
+  set_from_user_input(deg, "barrier equation degree [1,"
+                               + std::to_string(Globals::MAX_DEGREE) + "]");
 
   double l{0.};
   set_from_user_input(l, "length of the barrier (l)");
@@ -59,6 +289,22 @@ int main()
     barrier_down = Barrier{-p, l};
     break;
   }
+  default: {
+    if (deg < 1 || static_cast<std::size_t>(deg) > Globals::MAX_DEGREE) {
+      throw(std::runtime_error("unsupported barrier equation degree"));
+    }
+    std::cout << "Upper barrier equation is: a_" << deg << " * x^" << deg
+              << " + ... + a_1 * x + a_0, in the range [0,l]\n";
+    std::vector<double> coeff(static_cast<std::size_t>(deg) + 1);
+    for (std::size_t i{coeff.size()}; i-- > 0;) {
+      set_from_user_input(coeff[i], "a_" + std::to_string(i));
+    }
+
+    Pol p{coeff};
+    barrier_up   = Barrier{p, l};
+    barrier_down = Barrier{-p, l};
+    break;
+  }
   }
 
   if (n_sim == 1) { /* single particle simulation */
@@ -96,43 +342,22 @@ int main()
     set_from_user_input(mu_theta, "mu_theta");
     set_from_user_input(sigma_theta, "sigma_theta");
 
-    std::random_device rd;
-    std::default_random_engine eng{rd()};
-    std::normal_distribution y_dist{mu_y, sigma_y};
-    std::normal_distribution theta_dist{mu_theta, sigma_theta};
-
-    Sample statistics_y;
-    Sample statistics_theta;
+    std::uint64_t seed{0};
+    set_from_user_input(seed, "random seed");
 
-    double r1{barrier_up.pol()(0.)};
-
-    for (int i{0}; i != n_sim; ++i) {
-      double y0{y_dist(eng)};
-      while (std::abs(y0) > r1) {
-        y0 = y_dist(eng);
-      }
-
-      double theta0{theta_dist(eng)};
-
-      Trajectory traj{{0., y0}, theta0};
-      Result res = simulate_single_particle(barrier_up, barrier_down, traj);
-
-      if (res.get_x() == l) {
-        double yf     = res.get_y();
-        double thetaf = res.get_theta();
-        statistics_y.add(yf);
-        statistics_theta.add(thetaf);
-      }
-    }
+    ThreadPool pool;
+    MonteCarloResult result =
+        simulate_n_particles(barrier_up, barrier_down,
+                             {mu_y, sigma_y, mu_theta, sigma_theta},
+                             static_cast<std::size_t>(n_sim), seed, pool);
 
-    const auto stats_y     = statistics_y.statistics();
-    const auto stats_theta = statistics_theta.statistics();
+    const auto stats_y     = result.y.statistics();
+    const auto stats_theta = result.theta.statistics();
 
     std::cout
-        << "The number of generated particles is " << n_sim
+        << "The number of generated particles is " << result.n_generated
         << ", the number of particles exiting from the right side is "
-        << statistics_theta.size()
-        << '\n';
+        << result.theta.size() << '\n';
 
     std::cout << "The exit y values have a mean of " << stats_y.mean
               << ", a standard deviation of " << stats_y.std_dev
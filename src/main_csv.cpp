@@ -1,8 +1,14 @@
+#include "counters.hpp"
+#include "job.hpp"
 #include "kinematics.hpp"
-#include <fstream>
-#include <random>
+#include "montecarlo.hpp"
+#include "output.hpp"
+#include <chrono>
+#include <cstdint>
+#include <exception>
 
 std::string filename{"out.csv"};
+std::string binary_filename{"out.bin"};
 template<typename T>
 void set_from_user_input(T& var, std::string var_name)
 {
@@ -14,8 +20,107 @@ void set_from_user_input(T& var, std::string var_name)
   std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
 
-int main()
+namespace {
+
+// format is csv, bin64 or bin32; path is empty for the default file name
+void run(RunInfo const& info, std::string const& format, std::string path,
+         ThreadPool& pool, Sampling sampling = Sampling::pseudo_random)
+{
+  if (format != "csv" && format != "bin64" && format != "bin32") {
+    throw(std::runtime_error("invalid output format"));
+  }
+  if (path.empty()) {
+    path = format == "csv" ? filename : binary_filename;
+  }
+
+  Barrier barrier_up{info.l, info.r1, info.r2};
+  Barrier barrier_down{info.l, -info.r1, -info.r2};
+  Counters::reset();
+  auto const start = std::chrono::steady_clock::now();
+
+  // the output is written on a background thread while the next chunks are
+  // simulated; a whole wave of chunks of simulate_exits can be queued
+  auto simulate = [&](auto& writer) {
+    AsyncWriter async{[&](std::span<Exit const> exits) { writer.write(exits); },
+                      4 * std::size_t{pool.size()}};
+    simulate_exits(barrier_up, barrier_down, info.beam,
+                   static_cast<std::size_t>(info.n_particles), info.seed, pool,
+                   [&](std::vector<Exit> const& exits) { async.push(exits); },
+                   sampling);
+    async.close();
+    writer.close();
+
+    WriterStats const stats{async.stats()};
+    std::cout << "Writer: " << stats.n_chunks << " chunks, simulation waited "
+              << stats.full_seconds << " s for the output (" << stats.n_full
+              << " times), output waited " << stats.empty_seconds
+              << " s for the simulation, at most " << stats.max_queued
+              << " chunks queued\n";
+    if constexpr (Counters::ENABLED) {
+      std::cout << "Counters: ";
+      Counters::report(std::cout,
+                       std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count());
+      std::cout << '\n';
+    }
+  };
+
+  if (format == "csv") {
+    CsvWriter writer{path};
+    simulate(writer);
+    std::cout << "Output written to \"" << path << "\"\n";
+    std::cout << "Columns are: yf, thetaf\n";
+  } else {
+    BinaryWriter writer{path, info,
+                        format == "bin32" ? Precision::float32
+                                          : Precision::float64};
+    simulate(writer);
+    std::cout << "Output written to \"" << path << "\"\n";
+    std::cout << "Read it with read_exits\n";
+  }
+}
+
+} // namespace
+
+// without arguments every parameter is asked interactively, otherwise the
+// arguments are the key=value parameters of a job, or "--jobs <file>" runs
+// every job of a file, one per line, in this process and with one ThreadPool
+int main(int argc, char* argv[])
 {
+  std::vector<Job> const jobs{jobs_from_args(argc, argv)};
+  if (!jobs.empty()) {
+    ThreadPool pool;
+    for (std::size_t i{0}; i != jobs.size(); ++i) {
+      try {
+        Job const& job = jobs[i];
+        RunInfo const info{
+            job.get<double>("r1"),
+            job.get<double>("r2"),
+            job.get<double>("l"),
+            {job.get("mu_y", 0.), job.get("sigma_y", 1.),
+             job.get("mu_theta", 0.), job.get("sigma_theta", 3.)},
+            job.get<std::uint64_t>("n"),
+            job.get<std::uint64_t>("seed", 0)};
+        std::string const format{job.get<std::string>("format", "csv")};
+        std::string const path{job.get<std::string>("output", "")};
+        std::string const sampling{
+            job.get<std::string>("sampling", "pseudo_random")};
+        if (sampling != "pseudo_random" && sampling != "sobol") {
+          throw(std::runtime_error("invalid sampling"));
+        }
+        job.check_unused();
+        std::cout << "job " << i << ": ";
+        run(info, format, path, pool,
+            sampling == "sobol" ? Sampling::sobol : Sampling::pseudo_random);
+      } catch (std::exception const& e) {
+        std::cerr << "job " << i << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+      }
+    }
+    return EXIT_SUCCESS;
+  }
+
   double r1{0.};
   double r2{0.};
   double l{0.};
@@ -36,35 +141,14 @@ int main()
   set_from_user_input(mu_theta, "mu_theta");
   set_from_user_input(sigma_theta, "sigma_theta");
 
-  Barrier barrier_up{l, r1, r2};
-  Barrier barrier_down{l, -r1, -r2};
-
-  std::random_device rd;
-  std::default_random_engine eng{rd()};
-  std::normal_distribution y_dist{mu_y, sigma_y};
-  std::normal_distribution theta_dist{mu_theta, sigma_theta};
-
-  std::ofstream csv_file;
-  csv_file.open(filename);
+  std::uint64_t seed{0};
+  set_from_user_input(seed, "random seed");
 
-  for (int i{0}; i != N; ++i) {
-    double y0{y_dist(eng)};
-    while (std::abs(y0) > r1) {
-      y0 = y_dist(eng);
-    }
-
-    double theta0{theta_dist(eng)};
-
-    Trajectory traj{{0., y0}, theta0};
-    Result res = simulate_single_particle(barrier_up, barrier_down, traj);
+  std::string format{"csv"};
+  set_from_user_input(format, "output format (csv, bin64, bin32)");
 
-    if (res.get_x() == l) {
-      double yf     = res.get_y();
-      double thetaf = res.get_theta();
-      csv_file << yf << ", " << thetaf << '\n';
-    }
-  }
-  csv_file.close();
-  std::cout << "Output written to \"" << filename << "\"\n";
-  std::cout << "Columns are: yf, thetaf\n";
-}
\ No newline at end of file
+  ThreadPool pool;
+  run({r1, r2, l, {mu_y, sigma_y, mu_theta, sigma_theta},
+       static_cast<std::uint64_t>(N), seed},
+      format, "", pool);
+}
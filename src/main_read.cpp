@@ -0,0 +1,36 @@
+#include "output.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+// prints a binary output of multiple_particle_sim_csv as csv, the run
+// parameters being written as comments
+int main(int argc, char* argv[])
+{
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <binary output>\n";
+    return 1;
+  }
+
+  BinaryReader reader{argv[1]};
+  RunInfo const& info = reader.info();
+  std::cout << "# r1: " << info.r1 << '\n'
+            << "# r2: " << info.r2 << '\n'
+            << "# l: " << info.l << '\n'
+            << "# mu_y: " << info.beam.mu_y << '\n'
+            << "# sigma_y: " << info.beam.sigma_y << '\n'
+            << "# mu_theta: " << info.beam.mu_theta << '\n'
+            << "# sigma_theta: " << info.beam.sigma_theta << '\n'
+            << "# particles: " << info.n_particles << '\n'
+            << "# seed: " << info.seed << '\n'
+            << "# precision: float"
+            << 8 * static_cast<int>(reader.precision()) << '\n';
+
+  std::cout.precision(reader.precision() == Precision::float32 ? 9 : 17);
+  std::vector<Exit> exits;
+  while (reader.read(exits)) {
+    for (auto const& e : exits) {
+      std::cout << e.y << ", " << e.theta << '\n';
+    }
+  }
+}
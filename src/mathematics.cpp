@@ -1,204 +1,448 @@
 #include "mathematics.hpp"
 #include "globals.hpp"
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
-#include <numeric>
+#include <numbers>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
-Pol::Pol(std::vector<double> coeff)
-    : coeff_(coeff)
+namespace {
+template<typename T, typename C>
+void set_coeff(FixedVector<T, Globals::MAX_DEGREE + 1>& coeff_, C const& coeff)
 {
   assert(coeff.size() > 0);
+  if (coeff.size() > coeff_.capacity()) {
+    throw std::runtime_error("Polynomial degree too high, at most degree "
+                             + std::to_string(Globals::MAX_DEGREE)
+                             + " is supported");
+  }
+  for (T c : coeff) {
+    coeff_.push_back(c);
+  }
 }
+} // namespace
 
-double Pol::operator()(double x) const
+template<typename T>
+BasicPol<T>::BasicPol(std::vector<T> const& coeff)
 {
-  int i{-1};
-  return std::accumulate(coeff_.begin(), coeff_.end(), 0.,
-                         [x, &i](double acc, double coeff) {
-                           ++i;
-                           return acc += coeff * std::pow(x, i);
-                         });
+  set_coeff(coeff_, coeff);
 }
 
-double Pol::der(double x) const
+template<typename T>
+BasicPol<T>::BasicPol(std::initializer_list<T> coeff)
 {
-  double res{0};
-  int deg = static_cast<int>(coeff_.size()) - 1;
-  if (deg > 0) {
-    res += coeff_[1];
-  }
-  if (deg > 1) {
-    int i{1};
-    res = std::accumulate(coeff_.begin() + 2, coeff_.end(), res,
-                          [x, &i](double acc, double coeff) {
-                            ++i;
-                            return acc += coeff * i * std::pow(x, i - 1);
-                          });
+  set_coeff(coeff_, coeff);
+}
+
+template<typename T>
+T BasicPol<T>::operator()(T x) const
+{
+  return horner(coeff_, x);
+}
+
+template<typename T>
+T BasicPol<T>::der(T x) const
+{
+  T res{0};
+  for (std::size_t i{coeff_.size() - 1}; i > 0; --i) {
+    res = res * x + static_cast<T>(i) * coeff_[i];
   }
   return res;
 }
 
-std::size_t Pol::deg() const
+template<typename T>
+std::size_t BasicPol<T>::deg() const
 {
   return coeff_.size() - 1;
 }
 
-std::vector<double> Pol::coeff() const
+template<typename T>
+std::span<T const> BasicPol<T>::coeff() const
 {
-  return coeff_;
+  return {coeff_.begin(), coeff_.end()};
 }
 
-Pol Pol::operator-()
+template<typename T>
+BasicPol<T> BasicPol<T>::operator-() const
 {
-  Pol res{*this};
+  BasicPol res{*this};
   std::transform(res.coeff_.begin(), res.coeff_.end(), res.coeff_.begin(),
-                 [](double c) { return -c; });
+                 [](T c) { return -c; });
   return res;
 }
 
-std::vector<double> eq_solve(Pol const& pol1, Pol const& pol2)
+namespace {
+template<typename T>
+using Coeff = FixedVector<T, Globals::MAX_DEGREE + 1>;
+
+// a few Newton steps on [0]x^0 + [1]x^1 + ..., to recover the precision lost
+// by the closed form solutions
+template<typename T, typename C>
+void polish(BasicRoots<T>& sol, C const& coeff)
 {
-  std::vector<double> eq;
-  std::vector<double> minus;
-  std::size_t eq_deg;
-  if (pol2.deg() > pol1.deg()) {
-    eq_deg = pol2.deg();
-    eq     = pol2.coeff();
-    minus  = pol1.coeff();
-  } else {
-    eq_deg = pol1.deg();
-    eq     = pol1.coeff();
-    minus  = pol2.coeff();
+  for (T& x : sol) {
+    for (int i{0}; i != 2; ++i) {
+      T f{0};
+      T df{0};
+      for (std::size_t j{coeff.size()}; j-- > 0;) {
+        df = df * x + f;
+        f  = f * x + coeff[j];
+      }
+      if (df == 0) {
+        break;
+      }
+      x -= f / df;
+    }
   }
+  std::sort(sol.begin(), sol.end());
+}
 
-  minus.resize(eq_deg + 1, 0.0);
-
-  std::transform(minus.begin(), minus.end(), eq.begin(), eq.begin(),
-                 [](double m, double e) { return e - m; });
-
-  std::vector<double> sol;
+template<typename T>
+void trim(Coeff<T>& p)
+{
+  T scale{0};
+  for (T c : p) {
+    scale = std::max(scale, std::abs(c));
+  }
+  Coeff<T> res;
+  std::size_t deg{p.size()};
+  while (deg > 1
+         && std::abs(p[deg - 1])
+                <= Globals::sqrt_scaled_tolerance<T>(1e-12) * scale) {
+    --deg;
+  }
+  for (std::size_t i{0}; i != deg; ++i) {
+    res.push_back(p[i]);
+  }
+  p = res;
+}
 
-  switch (eq_deg) {
-  case 1: { // ax + b = 0
-    double a = eq[1];
-    double b = eq[0];
-    if (std::abs(a) < Globals::EPS) {
+// -(remainder of num / den)
+template<typename T>
+Coeff<T> neg_rem(Coeff<T> num, Coeff<T> const& den)
+{
+  std::size_t const dn{den.size() - 1};
+  for (std::size_t k{num.size() - 1}; k >= dn; --k) {
+    T q{num[k] / den[dn]};
+    for (std::size_t j{0}; j <= dn; ++j) {
+      num[k - dn + j] -= q * den[j];
+    }
+    if (k == 0) {
       break;
     }
-    sol.push_back({-b / a});
-    break;
   }
-  case 2: { // ax^2 + bx + c = 0
-    double a = eq[2];
-    double b = eq[1];
-    double c = eq[0];
+  Coeff<T> res;
+  for (std::size_t j{0}; j != dn; ++j) {
+    res.push_back(-num[j]);
+  }
+  if (res.empty()) {
+    res.push_back(0);
+  }
+  trim(res);
+  return res;
+}
 
-    if (std::abs(a) < Globals::EPS) { // bx + c=0
-      if (std::abs(b) < Globals::EPS) {
-        break;
+template<typename T>
+class Sturm
+{
+  std::array<Coeff<T>, Globals::MAX_DEGREE + 1> seq_;
+  std::size_t size_{0};
+
+ public:
+  explicit Sturm(Coeff<T> const& p)
+  {
+    seq_[size_++] = p;
+    Coeff<T> der;
+    for (std::size_t i{1}; i < p.size(); ++i) {
+      der.push_back(static_cast<T>(i) * p[i]);
+    }
+    seq_[size_++] = der;
+    while (seq_[size_ - 1].size() > 1) {
+      seq_[size_] = neg_rem(seq_[size_ - 2], seq_[size_ - 1]);
+      if (seq_[size_].size() == 1 && seq_[size_][0] == 0) {
+        break; // p has multiple roots, the sequence ends at their gcd
       }
-      sol.push_back({-c / b});
-      break;
+      ++size_;
     }
+  }
 
-    double discriminant = b * b - 4 * a * c;
-
-    if (discriminant < 0) {
-      break;
-    } else if (std::abs(discriminant) < Globals::EPS) {
-      sol.push_back({-b / (2 * a)});
-    } else {
-      double sqrt_disc = std::sqrt(discriminant);
-      sol.push_back((-b - sqrt_disc) / (2 * a));
-      sol.push_back((-b + sqrt_disc) / (2 * a));
+  // number of sign changes of the sequence in x
+  int changes(T x) const
+  {
+    int res{0};
+    T last{0};
+    for (std::size_t i{0}; i != size_; ++i) {
+      T v{horner(seq_[i], x)};
+      if (v != 0) {
+        if (last != 0 && (v > 0) != (last > 0)) {
+          ++res;
+        }
+        last = v;
+      }
     }
-    break;
+    return res;
   }
-  default:
-    throw std::runtime_error(
-        "Equation degree too high, only 2nd degree is supported");
+
+  Coeff<T> const& pol() const
+  {
+    return seq_[0];
   }
-  return sol;
-}
+};
 
-Vec2& Vec2::operator*=(double rhs)
+// root of p in (lo, hi], which contains exactly one root
+template<typename T>
+T polish_in(Coeff<T> const& p, T lo, T hi)
 {
-  x_ *= rhs;
-  y_ *= rhs;
-  return *this;
-}
+  T f_lo{horner(p, lo)};
+  T f_hi{horner(p, hi)};
+  if (f_lo == 0) {
+    // lo is a root itself, not in (lo, hi]: just above it p has the opposite
+    // sign of p(hi)
+    f_lo = -f_hi;
+  }
+  bool bracketed{(f_lo < 0) != (f_hi < 0)};
+  T const tol{Globals::scaled_tolerance<T>(1e-15)};
 
-Vec2& Vec2::operator+=(Vec2 rhs)
-{
-  x_ += rhs.x_;
-  y_ += rhs.y_;
-  return *this;
+  T x{(lo + hi) / 2};
+  for (int i{0}; i != 100; ++i) {
+    T f{0};
+    T df{0};
+    for (std::size_t j{p.size()}; j-- > 0;) {
+      df = df * x + f;
+      f  = f * x + p[j];
+    }
+    if (f == 0) {
+      return x;
+    }
+    if (bracketed) {
+      if ((f < 0) == (f_lo < 0)) {
+        lo = x;
+      } else {
+        hi = x;
+      }
+    }
+    T next{df != 0 ? x - f / df : lo};
+    if (!(next > lo && next < hi)) {
+      next = (lo + hi) / 2; // newton step left the bracket: bisect
+    }
+    if (std::abs(next - x) <= tol * (1 + std::abs(x))) {
+      return next;
+    }
+    x = next;
+  }
+  return x;
 }
 
-Vec2& Vec2::operator-=(Vec2 rhs)
+template<typename T>
+void isolate(Sturm<T> const& sturm, T lo, T hi, int v_lo, int v_hi,
+             BasicRoots<T>& sol, int depth)
 {
-  x_ -= rhs.x_;
-  y_ -= rhs.y_;
-  return *this;
+  int n{v_lo - v_hi};
+  if (n <= 0) {
+    return;
+  }
+  if (n == 1 || depth > 100
+      || hi - lo <= Globals::scaled_tolerance<T>(1e-15) * (1 + std::abs(lo))) {
+    sol.push_back(polish_in(sturm.pol(), lo, hi));
+    return;
+  }
+  T mid{(lo + hi) / 2};
+  int v_mid{sturm.changes(mid)};
+  isolate(sturm, lo, mid, v_lo, v_mid, sol, depth + 1);
+  isolate(sturm, mid, hi, v_mid, v_hi, sol, depth + 1);
 }
+} // namespace
 
-Vec2 operator*(double rhs, Vec2 const& lhs)
-{
-  Vec2 result{lhs};
-  result *= rhs;
-  return result;
-}
-Vec2 operator*(Vec2 const& rhs, double lhs)
-{
-  Vec2 result{rhs};
-  result *= lhs;
-  return result;
-}
-Vec2 operator/(Vec2 const& rhs, double lhs)
+template<typename T>
+BasicRoots<T> solve_cubic(std::type_identity_t<T> a, std::type_identity_t<T> b,
+                          std::type_identity_t<T> c, std::type_identity_t<T> d)
 {
-  Vec2 result{rhs};
-  result *= 1. / lhs;
-  return result;
-}
+  if constexpr (Globals::PRECISION_RATIO<T> > 1.) {
+    return narrow<T>(solve_cubic<double>(a, b, c, d));
+  }
+  if (std::abs(a) < Globals::EPS) {
+    return solve_quadratic<T>(b, c, d);
+  }
 
-Vec2 operator+(Vec2 const& lhs, Vec2 const& rhs)
-{
-  Vec2 result{lhs};
-  result += rhs;
-  return result;
-}
-Vec2 operator-(Vec2 const& lhs, Vec2 const& rhs)
-{
-  Vec2 result{lhs};
-  result -= rhs;
-  return result;
-}
+  // x = t - A / 3 gives the depressed cubic t^3 + p t + q = 0
+  T A{b / a};
+  T B{c / a};
+  T C{d / a};
+  T p{B - A * A / 3};
+  T q{2 * A * A * A / 27 - A * B / 3 + C};
+  T shift{-A / 3};
+  T discriminant{q * q / 4 + p * p * p / 27};
 
-bool Vec2::operator==(Vec2 const& rhs) const
-{
-  return (std::abs(x_ - rhs.x_) < Globals::EPS
-          && std::abs(y_ - rhs.y_) < Globals::EPS);
+  BasicRoots<T> sol;
+  if (discriminant > 0) { // one real root (Cardano)
+    T sqrt_disc{std::sqrt(discriminant)};
+    sol.push_back(std::cbrt(-q / 2 + sqrt_disc) + std::cbrt(-q / 2 - sqrt_disc)
+                  + shift);
+  } else if (p == 0) { // triple root
+    sol.push_back(shift);
+  } else { // three real roots (trigonometric method)
+    T r{2 * std::sqrt(-p / 3)};
+    T phi{std::acos(std::clamp(3 * q / (p * r), T{-1}, T{1}))};
+    for (int k{0}; k != 3; ++k) {
+      T const angle{(phi - 2 * std::numbers::pi_v<T> * static_cast<T>(k)) / 3};
+      sol.push_back(r * std::cos(angle) + shift);
+    }
+  }
+  polish(sol, std::array{C, B, A, T{1}});
+  return sol;
 }
 
-double dot(Vec2 const& lhs, Vec2 const& rhs)
+template<typename T>
+BasicRoots<T>
+solve_quartic(std::type_identity_t<T> a, std::type_identity_t<T> b,
+              std::type_identity_t<T> c, std::type_identity_t<T> d,
+              std::type_identity_t<T> e)
 {
-  return lhs.x_ * rhs.x_ + lhs.y_ * rhs.y_;
+  if constexpr (Globals::PRECISION_RATIO<T> > 1.) {
+    return narrow<T>(solve_quartic<double>(a, b, c, d, e));
+  }
+  if (std::abs(a) < Globals::EPS) {
+    return solve_cubic<T>(b, c, d, e);
+  }
+
+  // x = y - A / 4 gives the depressed quartic y^4 + p y^2 + q y + r = 0
+  T A{b / a};
+  T B{c / a};
+  T C{d / a};
+  T D{e / a};
+  T p{B - 3 * A * A / 8};
+  T q{C - A * B / 2 + A * A * A / 8};
+  T r{D - A * C / 4 + A * A * B / 16 - 3 * A * A * A * A / 256};
+  T shift{-A / 4};
+  T const tol{Globals::scaled_tolerance<T>(1e-14)};
+
+  BasicRoots<T> sol;
+  if (std::abs(q) < tol) { // biquadratic: z = y^2
+    for (T z : solve_quadratic<T>(1, p, r)) {
+      if (z > 0) {
+        sol.push_back(std::sqrt(z) + shift);
+        sol.push_back(-std::sqrt(z) + shift);
+      } else if (z > -tol) {
+        sol.push_back(shift);
+      }
+    }
+  } else {
+    // (y^2 + p/2 + m)^2 = 2m (y - q/4m)^2, with m the largest (and positive)
+    // root of the resolvent cubic
+    BasicRoots<T> m_sol = solve_cubic<T>(8, 8 * p, 2 * p * p - 8 * r, -q * q);
+    T m{*std::max_element(m_sol.begin(), m_sol.end())};
+    T s{std::sqrt(2 * m)};
+    for (T y : solve_quadratic<T>(1, -s, p / 2 + m + q / (2 * s))) {
+      sol.push_back(y + shift);
+    }
+    for (T y : solve_quadratic<T>(1, s, p / 2 + m - q / (2 * s))) {
+      sol.push_back(y + shift);
+    }
+  }
+  polish(sol, std::array{D, C, B, A, T{1}});
+  return sol;
 }
 
-double Vec2::norm() const
+template<typename T>
+BasicRoots<T> solve_sturm(std::span<std::type_identity_t<T> const> coeff,
+                          std::type_identity_t<T> x_min,
+                          std::type_identity_t<T> x_max)
 {
-  return std::sqrt(dot(*this, *this));
+  if constexpr (Globals::PRECISION_RATIO<T> > 1.) {
+    std::array<double, Globals::MAX_DEGREE + 1> wide{};
+    std::copy(coeff.begin(), coeff.end(), wide.begin());
+    return narrow<T>(
+        solve_sturm<double>({wide.data(), coeff.size()}, x_min, x_max));
+  }
+
+  Coeff<T> p;
+  for (T c : coeff) {
+    p.push_back(c);
+  }
+  trim(p);
+  if (p.size() < 2) {
+    return {};
+  }
+
+  // all the roots lie within the Cauchy bound
+  T lead{p[p.size() - 1]};
+  T bound{0};
+  for (std::size_t i{0}; i + 1 < p.size(); ++i) {
+    p[i] /= lead;
+    bound = std::max(bound, std::abs(p[i]));
+  }
+  p[p.size() - 1] = 1;
+  bound += 1;
+  x_min = std::max(x_min, -bound);
+  x_max = std::min(x_max, bound);
+
+  BasicRoots<T> sol;
+  if (x_min >= x_max) {
+    return sol;
+  }
+  Sturm<T> sturm{p};
+  isolate(sturm, x_min, x_max, sturm.changes(x_min), sturm.changes(x_max), sol,
+          0);
+  return sol;
 }
 
-Vec2 Vec2::ortho() const
+template<typename T>
+BasicRoots<T> eq_solve(BasicPol<T> const& pol1, BasicPol<T> const& pol2,
+                       std::type_identity_t<T> x_min,
+                       std::type_identity_t<T> x_max)
 {
-  return {-y_, x_};
+  Counters::add(Counters::Event::eq_solves);
+  BasicPol<T> const& high = pol2.deg() > pol1.deg() ? pol2 : pol1;
+  BasicPol<T> const& low  = pol2.deg() > pol1.deg() ? pol1 : pol2;
+  std::size_t eq_deg{high.deg()};
+
+  // eq = high - low
+  std::array<T, Globals::MAX_DEGREE + 1> eq{};
+  std::copy(high.coeff().begin(), high.coeff().end(), eq.begin());
+  std::transform(low.coeff().begin(), low.coeff().end(), eq.begin(),
+                 eq.begin(), [](T m, T e) { return e - m; });
+
+  // as in the closed forms, a negligible leading coefficient lowers the degree
+  while (eq_deg > 4 && std::abs(eq[eq_deg]) < Globals::EPS) {
+    --eq_deg;
+  }
+
+  BasicRoots<T> sol;
+  switch (eq_deg) {
+  case 0:
+    throw std::runtime_error("Equation degree must be at least 1");
+  case 1: // ax + b = 0
+    sol = solve_linear<T>(eq[1], eq[0]);
+    break;
+  case 2: // ax^2 + bx + c = 0
+    sol = solve_quadratic<T>(eq[2], eq[1], eq[0]);
+    break;
+  case 3:
+    sol = solve_cubic<T>(eq[3], eq[2], eq[1], eq[0]);
+    break;
+  case 4:
+    sol = solve_quartic<T>(eq[4], eq[3], eq[2], eq[1], eq[0]);
+    break;
+  default:
+    return solve_sturm<T>({eq.data(), eq_deg + 1}, x_min, x_max);
+  }
+  keep_in(sol, x_min, x_max);
+  return sol;
 }
 
-double Vec2::dist2(Vec2 const& v) const
-{
-  return dot(*this - v, *this - v);
-}
\ No newline at end of file
+// the engines of every supported scalar type
+#define INSTANTIATE_MATHEMATICS(T)                                            \
+  template class BasicPol<T>;                                                 \
+  template BasicRoots<T> solve_cubic<T>(T, T, T, T);                          \
+  template BasicRoots<T> solve_quartic<T>(T, T, T, T, T);                     \
+  template BasicRoots<T> solve_sturm<T>(std::span<T const>, T, T);            \
+  template BasicRoots<T> eq_solve<T>(BasicPol<T> const&, BasicPol<T> const&,  \
+                                     T, T);
+
+INSTANTIATE_MATHEMATICS(float)
+INSTANTIATE_MATHEMATICS(double)
+INSTANTIATE_MATHEMATICS(long double)
+#undef INSTANTIATE_MATHEMATICS
@@ -1,49 +1,405 @@
 #ifndef MATHEMATICS_HPP
 #define MATHEMATICS_HPP
 
+#include "counters.hpp"
+#include "fixed_vector.hpp"
+#include "globals.hpp"
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <initializer_list>
+#include <limits>
+#include <span>
+#include <type_traits>
 #include <vector>
 
-class Pol
+// the engine is templated on the scalar type T: float, double or long double
+// are instantiated in the .cpp files, and the double engine has the names
+// without the Basic prefix (Pol, Vec2, ...). Scalar parameters that are not
+// needed to deduce T are std::type_identity_t<T>, so that double literals can
+// be passed to the float engine; the solvers, that have only such parameters,
+// default to double. The float engine is a storage and validation mode, not a
+// faster one: its solvers work in double (see narrow), and simulate_batch,
+// the SIMD path, is double only, so it runs no faster than the double engine.
+
+// evaluates [0]x^0 + [1]x^1 + ... with Horner's method
+template<typename C, typename T>
+constexpr T horner(C const& coeff, T x)
+{
+  T res{0};
+  for (std::size_t i{coeff.size()}; i-- > 0;) {
+    res = res * x + coeff[i];
+  }
+  return res;
+}
+
+template<typename T>
+class BasicPol
 {
   // [0]x^0 + [1]x^1 + [2]x^2 ...
-  std::vector<double> coeff_;
+  FixedVector<T, Globals::MAX_DEGREE + 1> coeff_;
 
  public:
-  Pol(std::vector<double> coeff);
+  // throws if the degree is higher than Globals::MAX_DEGREE
+  BasicPol(std::vector<T> const& coeff);
+  BasicPol(std::initializer_list<T> coeff);
 
-  double operator()(double x) const;
-  double der(double x) const;
+  T operator()(T x) const;
+  T der(T x) const;
   std::size_t deg() const;
-  std::vector<double> coeff() const;
+  std::span<T const> coeff() const;
 
-  Pol operator-();
+  BasicPol operator-() const;
 };
 
-std::vector<double> eq_solve(Pol const& pol1, Pol const& pol2);
+using Pol = BasicPol<double>;
+
+// polynomial of degree N known at compile time, the coefficients of the
+// derivative are computed once at construction
+template<std::size_t N, typename T = double>
+class FixedPol
+{
+  // [0]x^0 + [1]x^1 + ... + [N]x^N
+  std::array<T, N + 1> coeff_{};
+  std::array<T, N> der_coeff_{};
+
+ public:
+  constexpr FixedPol(std::convertible_to<T> auto... coeff)
+    requires(sizeof...(coeff) == N + 1)
+      : coeff_{static_cast<T>(coeff)...}
+  {
+    set_der();
+  }
+  explicit FixedPol(BasicPol<T> const& pol)
+  {
+    assert(pol.deg() == N);
+    for (std::size_t i{0}; i <= N; ++i) {
+      coeff_[i] = pol.coeff()[i];
+    }
+    set_der();
+  }
+
+  constexpr T operator()(T x) const
+  {
+    return horner(coeff_, x);
+  }
+  constexpr T der(T x) const
+  {
+    return horner(der_coeff_, x);
+  }
+  static constexpr std::size_t deg()
+  {
+    return N;
+  }
+  constexpr std::array<T, N + 1> const& coeff() const
+  {
+    return coeff_;
+  }
+
+ private:
+  constexpr void set_der()
+  {
+    for (std::size_t i{1}; i <= N; ++i) {
+      der_coeff_[i - 1] = static_cast<T>(i) * coeff_[i];
+    }
+  }
+};
+
+template<typename T>
+using BasicRoots = FixedVector<T, Globals::MAX_DEGREE>;
+using Roots      = BasicRoots<double>;
+
+// roots found in double, rounded to T: the solvers of the types less precise
+// than double work in double, where the closed forms, with a leading
+// coefficient as small as Globals::EPS, and the Sturm sequences keep enough
+// digits
+template<typename T>
+BasicRoots<T> narrow(Roots const& wide)
+{
+  BasicRoots<T> sol;
+  for (double x : wide) {
+    sol.push_back(static_cast<T>(x));
+  }
+  return sol;
+}
+
+// real solutions of a * x + b = 0
+template<typename T = double>
+BasicRoots<T> solve_linear(std::type_identity_t<T> a,
+                           std::type_identity_t<T> b)
+{
+  BasicRoots<T> sol;
+  if (std::abs(a) >= Globals::EPS) {
+    sol.push_back(-b / a);
+  }
+  return sol;
+}
+
+// real solutions of a * x^2 + b * x + c = 0
+template<typename T = double>
+BasicRoots<T> solve_quadratic(std::type_identity_t<T> a,
+                              std::type_identity_t<T> b,
+                              std::type_identity_t<T> c)
+{
+  if constexpr (Globals::PRECISION_RATIO<T> > 1.) {
+    return narrow<T>(solve_quadratic<double>(a, b, c));
+  }
+  if (std::abs(a) < Globals::EPS) {
+    return solve_linear<T>(b, c);
+  }
+
+  BasicRoots<T> sol;
+  T discriminant = b * b - 4 * a * c;
+
+  if (discriminant < 0) {
+    return sol;
+  } else if (std::abs(discriminant) < Globals::EPS_OF<T>) {
+    sol.push_back(-b / (2 * a));
+  } else {
+    T sqrt_disc = std::sqrt(discriminant);
+    sol.push_back((-b - sqrt_disc) / (2 * a));
+    sol.push_back((-b + sqrt_disc) / (2 * a));
+  }
+  return sol;
+}
+
+// real solutions of a * x^3 + b * x^2 + c * x + d = 0, in closed form
+template<typename T = double>
+BasicRoots<T> solve_cubic(std::type_identity_t<T> a, std::type_identity_t<T> b,
+                          std::type_identity_t<T> c,
+                          std::type_identity_t<T> d);
+
+// real solutions of a * x^4 + b * x^3 + c * x^2 + d * x + e = 0, in closed
+// form (Ferrari)
+template<typename T = double>
+BasicRoots<T>
+solve_quartic(std::type_identity_t<T> a, std::type_identity_t<T> b,
+              std::type_identity_t<T> c, std::type_identity_t<T> d,
+              std::type_identity_t<T> e);
+
+// real solutions in (x_min, x_max] of [0]x^0 + [1]x^1 + ... = 0, for any
+// degree: roots are isolated with a Sturm sequence and polished with a
+// safeguarded Newton method
+template<typename T = double>
+BasicRoots<T> solve_sturm(std::span<std::type_identity_t<T> const> coeff,
+                          std::type_identity_t<T> x_min,
+                          std::type_identity_t<T> x_max);
+
+// removes the solutions outside [x_min, x_max]
+template<typename T>
+void keep_in(BasicRoots<T>& sol, std::type_identity_t<T> x_min,
+             std::type_identity_t<T> x_max)
+{
+  BasicRoots<T> res;
+  for (T x : sol) {
+    if (x >= x_min && x <= x_max) {
+      res.push_back(x);
+    }
+  }
+  sol = res;
+}
+
+// real solutions of pol1(x) = pol2(x) in [x_min, x_max], the default interval
+// being the whole real line: degrees up to 4 are solved in closed form, higher
+// ones need a bounded interval to be solved efficiently
+template<typename T>
+BasicRoots<T>
+eq_solve(BasicPol<T> const& pol1, BasicPol<T> const& pol2,
+         std::type_identity_t<T> x_min = -std::numeric_limits<T>::infinity(),
+         std::type_identity_t<T> x_max = std::numeric_limits<T>::infinity());
+
+// real solutions of line(x) = pol(x) in [x_min, x_max], specialised on the
+// degree of pol
+template<std::size_t N, typename T>
+BasicRoots<T>
+eq_solve(FixedPol<1, T> const& line, FixedPol<N, T> const& pol,
+         std::type_identity_t<T> x_min = -std::numeric_limits<T>::infinity(),
+         std::type_identity_t<T> x_max = std::numeric_limits<T>::infinity())
+{
+  static_assert(N == 1 || N == 2, "only 1st and 2nd degree are specialised");
+  Counters::add(Counters::Event::eq_solves);
+  auto const& l = line.coeff();
+  auto const& p = pol.coeff();
+  BasicRoots<T> sol;
+  if constexpr (N == 1) {
+    sol = solve_linear<T>(l[1] - p[1], l[0] - p[0]);
+  } else {
+    sol = solve_quadratic<T>(p[2], p[1] - l[1], p[0] - l[0]);
+  }
+  keep_in(sol, x_min, x_max);
+  return sol;
+}
+
+template<typename T>
+BasicRoots<T>
+eq_solve(FixedPol<1, T> const& line, BasicPol<T> const& pol,
+         std::type_identity_t<T> x_min = -std::numeric_limits<T>::infinity(),
+         std::type_identity_t<T> x_max = std::numeric_limits<T>::infinity())
+{
+  return eq_solve(BasicPol<T>{line.coeff()[0], line.coeff()[1]}, pol, x_min,
+                  x_max);
+}
 
-struct Vec2
+// every operation is inline, so that the bounce arithmetic compiles to plain
+// floating point instructions without LTO
+template<typename T>
+struct BasicVec2
 {
-  double x_;
-  double y_;
+  T x_;
+  T y_;
 
-  bool operator==(Vec2 const& rhs) const;
-  Vec2& operator*=(double rhs);
-  Vec2& operator+=(Vec2 rhs);
-  Vec2& operator-=(Vec2 rhs);
+  constexpr bool operator==(BasicVec2 const& rhs) const;
+  constexpr BasicVec2& operator*=(T rhs);
+  constexpr BasicVec2& operator+=(BasicVec2 rhs);
+  constexpr BasicVec2& operator-=(BasicVec2 rhs);
 
-  double norm() const;
-  Vec2 ortho() const;
+  T norm() const;
+  constexpr BasicVec2 ortho() const;
 
-  double dist2(Vec2 const& v) const;
+  constexpr T dist2(BasicVec2 const& v) const;
+
+  // scales the vector to unit length, in place
+  BasicVec2& normalize();
+  // mirror image across the line with unit normal n: v - 2 (v . n) n
+  constexpr BasicVec2 reflect(BasicVec2 const& n) const;
 };
 
-Vec2 operator*(double rhs, Vec2 const& lhs);
-Vec2 operator*(Vec2 const& rhs, double lhs);
-Vec2 operator/(Vec2 const& rhs, double lhs);
+using Vec2 = BasicVec2<double>;
+
+template<typename T>
+constexpr BasicVec2<T> operator*(std::type_identity_t<T> rhs,
+                                 BasicVec2<T> const& lhs);
+template<typename T>
+constexpr BasicVec2<T> operator*(BasicVec2<T> const& rhs,
+                                 std::type_identity_t<T> lhs);
+template<typename T>
+constexpr BasicVec2<T> operator/(BasicVec2<T> const& rhs,
+                                 std::type_identity_t<T> lhs);
+
+template<typename T>
+constexpr BasicVec2<T> operator+(BasicVec2<T> const& lhs,
+                                 BasicVec2<T> const& rhs);
+template<typename T>
+constexpr BasicVec2<T> operator-(BasicVec2<T> const& lhs,
+                                 BasicVec2<T> const& rhs);
+
+template<typename T>
+constexpr T dot(BasicVec2<T> const& rhs, BasicVec2<T> const& lhs);
+
+template<typename T>
+constexpr bool BasicVec2<T>::operator==(BasicVec2 const& rhs) const
+{
+  // |x_ - rhs.x_| < EPS, written without std::abs to be constexpr
+  T const dx{x_ - rhs.x_};
+  T const dy{y_ - rhs.y_};
+  T const eps{Globals::EPS_OF<T>};
+  return dx < eps && -dx < eps && dy < eps && -dy < eps;
+}
+
+template<typename T>
+constexpr BasicVec2<T>& BasicVec2<T>::operator*=(T rhs)
+{
+  x_ *= rhs;
+  y_ *= rhs;
+  return *this;
+}
 
-Vec2 operator+(Vec2 const& lhs, Vec2 const& rhs);
-Vec2 operator-(Vec2 const& lhs, Vec2 const& rhs);
+template<typename T>
+constexpr BasicVec2<T>& BasicVec2<T>::operator+=(BasicVec2 rhs)
+{
+  x_ += rhs.x_;
+  y_ += rhs.y_;
+  return *this;
+}
+
+template<typename T>
+constexpr BasicVec2<T>& BasicVec2<T>::operator-=(BasicVec2 rhs)
+{
+  x_ -= rhs.x_;
+  y_ -= rhs.y_;
+  return *this;
+}
+
+template<typename T>
+T BasicVec2<T>::norm() const
+{
+  return std::sqrt(dot(*this, *this));
+}
+
+template<typename T>
+constexpr BasicVec2<T> BasicVec2<T>::ortho() const
+{
+  return {-y_, x_};
+}
 
-double dot(Vec2 const& rhs, Vec2 const& lhs);
+template<typename T>
+constexpr T BasicVec2<T>::dist2(BasicVec2 const& v) const
+{
+  BasicVec2 const d{*this - v};
+  return dot(d, d);
+}
+
+template<typename T>
+BasicVec2<T>& BasicVec2<T>::normalize()
+{
+  return *this *= T{1} / norm();
+}
+
+template<typename T>
+constexpr BasicVec2<T> BasicVec2<T>::reflect(BasicVec2 const& n) const
+{
+  T const k{2 * dot(*this, n)};
+  return {x_ - k * n.x_, y_ - k * n.y_};
+}
+
+template<typename T>
+constexpr BasicVec2<T> operator*(std::type_identity_t<T> rhs,
+                                 BasicVec2<T> const& lhs)
+{
+  BasicVec2<T> result{lhs};
+  result *= rhs;
+  return result;
+}
+template<typename T>
+constexpr BasicVec2<T> operator*(BasicVec2<T> const& rhs,
+                                 std::type_identity_t<T> lhs)
+{
+  BasicVec2<T> result{rhs};
+  result *= lhs;
+  return result;
+}
+template<typename T>
+constexpr BasicVec2<T> operator/(BasicVec2<T> const& rhs,
+                                 std::type_identity_t<T> lhs)
+{
+  BasicVec2<T> result{rhs};
+  result *= T{1} / lhs;
+  return result;
+}
+
+template<typename T>
+constexpr BasicVec2<T> operator+(BasicVec2<T> const& lhs,
+                                 BasicVec2<T> const& rhs)
+{
+  BasicVec2<T> result{lhs};
+  result += rhs;
+  return result;
+}
+template<typename T>
+constexpr BasicVec2<T> operator-(BasicVec2<T> const& lhs,
+                                 BasicVec2<T> const& rhs)
+{
+  BasicVec2<T> result{lhs};
+  result -= rhs;
+  return result;
+}
+
+template<typename T>
+constexpr T dot(BasicVec2<T> const& lhs, BasicVec2<T> const& rhs)
+{
+  return lhs.x_ * rhs.x_ + lhs.y_ * rhs.y_;
+}
 
-#endif
\ No newline at end of file
+#endif
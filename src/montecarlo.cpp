@@ -0,0 +1,440 @@
+#include "montecarlo.hpp"
+#include "exit_map.hpp"
+#include "random.hpp"
+#include "unfolding.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <optional>
+#include <span>
+#include <stdexcept>
+
+namespace {
+
+std::size_t n_chunks(std::size_t n)
+{
+  return (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
+// streams of the generator, the counter being the index of the particle
+constexpr std::uint64_t Y_STREAM{0};
+constexpr std::uint64_t THETA_STREAM{1};
+// initial conditions are sampled in batches of BATCH particles
+constexpr std::size_t BATCH{256};
+
+// initial conditions of the particles, as pure functions of (seed, index)
+class InitialConditions
+{
+  Sampling sampling_;
+  Philox philox_;
+  Sobol sobol_;
+  double mu_theta_;
+  double sigma_theta_;
+
+ public:
+  InitialConditions(Sampling sampling, std::uint64_t seed, Beam const& beam,
+                    std::size_t n)
+      : sampling_{sampling}
+      , philox_{seed}
+      , sobol_{seed}
+      , mu_theta_{beam.mu_theta}
+      , sigma_theta_{beam.sigma_theta}
+  {
+    if (sampling == Sampling::sobol && n > std::size_t{1} << 32) {
+      throw std::invalid_argument{
+          "The Sobol sequence is limited to 2^32 particles"};
+    }
+  }
+
+  // uniforms of y0, to be transformed by the y0 distribution, and values of
+  // theta0 of the particles [first, first + u_y.size())
+  void operator()(std::size_t first, std::span<double> u_y,
+                  std::span<double> theta0) const
+  {
+    if (sampling_ == Sampling::sobol) {
+      fill_sobol(sobol_, first, u_y, theta0);
+      inverse_normal_cdf(theta0);
+      for (double& x : theta0) {
+        x = mu_theta_ + sigma_theta_ * x;
+      }
+    } else {
+      fill_uniform(philox_, Y_STREAM, first, u_y);
+      fill_normal(philox_, THETA_STREAM, first, mu_theta_, sigma_theta_,
+                  theta0);
+    }
+  }
+};
+
+// exact exit state of a particle
+Result simulate_exact(Barrier const& barrier_up, Barrier const& barrier_down,
+                      std::optional<Unfolding> const& unfolding,
+                      Trajectory const& traj)
+{
+  return unfolding ? unfolding->simulate(traj)
+                   : simulate_single_particle(barrier_up, barrier_down, traj);
+}
+
+// on_exit(yf, thetaf) is called for every particle exiting from the right
+// side; particles are looked up in exit_map, if any, and simulated where it
+// has no value
+template<typename F>
+void simulate_particles(Barrier const& barrier_up, Barrier const& barrier_down,
+                        std::optional<Unfolding> const& unfolding,
+                        ExitMap const* exit_map, std::span<double const> y0,
+                        std::span<double const> theta0, F&& on_exit)
+{
+  double l{barrier_up.max()};
+  for (std::size_t i{0}; i != y0.size(); ++i) {
+    if (exit_map) {
+      if (auto const e = exit_map->lookup(y0[i], theta0[i])) {
+        if (e->right) {
+          on_exit(e->y, e->theta);
+        }
+        continue;
+      }
+    }
+
+    Result res = simulate_exact(barrier_up, barrier_down, unfolding,
+                                Trajectory{{0., y0[i]}, theta0[i]});
+    if (res.get_x() == l) {
+      on_exit(res.get_y(), res.get_theta());
+    }
+  }
+}
+
+// on_exit(yf, thetaf) is called for every particle of the chunk exiting from
+// the right side
+template<typename F>
+void simulate_chunk(Barrier const& barrier_up, Barrier const& barrier_down,
+                    std::optional<Unfolding> const& unfolding,
+                    ExitMap const* exit_map, TruncatedNormal const& y_dist,
+                    InitialConditions const& initial, std::size_t n,
+                    std::size_t chunk, F&& on_exit)
+{
+  std::array<double, BATCH> y0;
+  std::array<double, BATCH> theta0;
+
+  std::size_t const first{chunk * CHUNK_SIZE};
+  std::size_t const last{std::min(n, first + CHUNK_SIZE)};
+  for (std::size_t b{first}; b < last; b += BATCH) {
+    std::size_t const size{std::min(BATCH, last - b)};
+    initial(b, std::span{y0}.first(size), std::span{theta0}.first(size));
+    y_dist(std::span{y0}.first(size));
+    simulate_particles(barrier_up, barrier_down, unfolding, exit_map,
+                       std::span{y0}.first(size),
+                       std::span{theta0}.first(size), on_exit);
+  }
+}
+
+// y0 is in [-r1, r1]
+TruncatedNormal y0_distribution(Barrier const& barrier_up, Beam const& beam)
+{
+  double const r1{barrier_up.pol()(0.)};
+  return {beam.mu_y, beam.sigma_y, -r1, r1};
+}
+
+struct ChunkResult
+{
+  Sample y;
+  Sample theta;
+};
+
+// simulates the chunks [first, last) of n particles and merges their results
+// into result in chunk order, so that rounding does not depend on scheduling
+void simulate_chunks(Barrier const& barrier_up, Barrier const& barrier_down,
+                     std::optional<Unfolding> const& unfolding,
+                     ExitMap const* exit_map, TruncatedNormal const& y_dist,
+                     InitialConditions const& initial, std::size_t n,
+                     std::size_t first, std::size_t last, ThreadPool& pool,
+                     MonteCarloResult& result)
+{
+  std::vector<ChunkResult> chunks(last - first);
+  pool.parallel_for(chunks.size(), [&](std::size_t c) {
+    ChunkResult& res = chunks[c];
+    simulate_chunk(barrier_up, barrier_down, unfolding, exit_map, y_dist,
+                   initial, n, first + c,
+                   [&](double yf, double thetaf) {
+                     res.y.add(yf);
+                     res.theta.add(thetaf);
+                   });
+  });
+
+  for (auto const& c : chunks) {
+    result.y.merge(c.y);
+    result.theta.merge(c.theta);
+  }
+}
+
+} // namespace
+
+MonteCarloResult simulate_n_particles(Barrier const& barrier_up,
+                                      Barrier const& barrier_down,
+                                      Beam const& beam, std::size_t n,
+                                      std::uint64_t seed, ThreadPool& pool,
+                                      Sampling sampling)
+{
+  auto const unfolding = Unfolding::make(barrier_up, barrier_down);
+  TruncatedNormal const y_dist{y0_distribution(barrier_up, beam)};
+  InitialConditions const initial{sampling, seed, beam, n};
+
+  MonteCarloResult result;
+  result.n_generated = n;
+  simulate_chunks(barrier_up, barrier_down, unfolding, nullptr, y_dist,
+                  initial, n, 0, n_chunks(n), pool, result);
+  return result;
+}
+
+MonteCarloResult simulate_n_particles(ExitMap const& exit_map,
+                                      Barrier const& barrier_up,
+                                      Barrier const& barrier_down,
+                                      Beam const& beam, std::size_t n,
+                                      std::uint64_t seed, ThreadPool& pool,
+                                      Sampling sampling)
+{
+  if (!exit_map.matches(barrier_up, barrier_down)) {
+    throw std::invalid_argument{
+        "The exit map was built for different barriers"};
+  }
+  auto const unfolding = Unfolding::make(barrier_up, barrier_down);
+  TruncatedNormal const y_dist{y0_distribution(barrier_up, beam)};
+  InitialConditions const initial{sampling, seed, beam, n};
+
+  MonteCarloResult result;
+  result.n_generated = n;
+  simulate_chunks(barrier_up, barrier_down, unfolding, &exit_map, y_dist,
+                  initial, n, 0, n_chunks(n), pool, result);
+  return result;
+}
+
+ExitMapAccuracy exit_map_accuracy(ExitMap const& exit_map,
+                                  Barrier const& barrier_up,
+                                  Barrier const& barrier_down,
+                                  Beam const& beam, std::size_t n,
+                                  std::uint64_t seed, ThreadPool& pool)
+{
+  if (!exit_map.matches(barrier_up, barrier_down)) {
+    throw std::invalid_argument{
+        "The exit map was built for different barriers"};
+  }
+  auto const unfolding = Unfolding::make(barrier_up, barrier_down);
+  TruncatedNormal const y_dist{y0_distribution(barrier_up, beam)};
+  InitialConditions const initial{Sampling::pseudo_random, seed, beam, n};
+  double const l{barrier_up.max()};
+
+  // sums of the squared errors, per chunk, then merged in chunk order
+  struct ChunkAccuracy
+  {
+    ExitMapAccuracy acc;
+    double y_sum2{0.};
+    double theta_sum2{0.};
+  };
+  std::vector<ChunkAccuracy> chunks(n_chunks(n));
+  pool.parallel_for(chunks.size(), [&](std::size_t c) {
+    ChunkAccuracy& res = chunks[c];
+    std::array<double, BATCH> y0;
+    std::array<double, BATCH> theta0;
+    std::size_t const first{c * CHUNK_SIZE};
+    std::size_t const last{std::min(n, first + CHUNK_SIZE)};
+    for (std::size_t b{first}; b < last; b += BATCH) {
+      std::size_t const size{std::min(BATCH, last - b)};
+      initial(b, std::span{y0}.first(size), std::span{theta0}.first(size));
+      for (std::size_t i{0}; i != size; ++i) {
+        ++res.acc.n;
+        y0[i] = y_dist(y0[i]);
+        auto const e = exit_map.lookup(y0[i], theta0[i]);
+        if (!e) {
+          continue;
+        }
+        ++res.acc.served;
+        Result const exact{simulate_exact(barrier_up, barrier_down, unfolding,
+                                          Trajectory{{0., y0[i]}, theta0[i]})};
+        bool const right{exact.get_x() == l};
+        if (right != e->right) {
+          ++res.acc.misclassified;
+        } else if (right) {
+          double const dy{std::abs(e->y - exact.get_y())};
+          double const dtheta{std::abs(e->theta - exact.get_theta())};
+          ++res.acc.n_compared;
+          res.acc.y_max_error     = std::max(res.acc.y_max_error, dy);
+          res.acc.theta_max_error = std::max(res.acc.theta_max_error, dtheta);
+          res.y_sum2 += dy * dy;
+          res.theta_sum2 += dtheta * dtheta;
+        }
+      }
+    }
+  });
+
+  ExitMapAccuracy result;
+  double y_sum2{0.};
+  double theta_sum2{0.};
+  for (auto const& c : chunks) {
+    result.n += c.acc.n;
+    result.served += c.acc.served;
+    result.misclassified += c.acc.misclassified;
+    result.n_compared += c.acc.n_compared;
+    result.y_max_error     = std::max(result.y_max_error, c.acc.y_max_error);
+    result.theta_max_error = std::max(result.theta_max_error,
+                                      c.acc.theta_max_error);
+    y_sum2 += c.y_sum2;
+    theta_sum2 += c.theta_sum2;
+  }
+  if (result.n_compared != 0) {
+    double const m{static_cast<double>(result.n_compared)};
+    result.y_rms_error     = std::sqrt(y_sum2 / m);
+    result.theta_rms_error = std::sqrt(theta_sum2 / m);
+  }
+  return result;
+}
+
+SequentialResult simulate_until(Barrier const& barrier_up,
+                                Barrier const& barrier_down, Beam const& beam,
+                                StoppingRule const& rule, std::uint64_t seed,
+                                ThreadPool& pool)
+{
+  if (!(rule.mean_error > 0.) && !(rule.std_dev_error > 0.)) {
+    throw std::invalid_argument{"The stopping rule has no target"};
+  }
+  auto const start = std::chrono::steady_clock::now();
+
+  auto const unfolding = Unfolding::make(barrier_up, barrier_down);
+  TruncatedNormal const y_dist{y0_distribution(barrier_up, beam)};
+  std::size_t const n{rule.max_particles};
+  InitialConditions const initial{Sampling::pseudo_random, seed, beam, n};
+
+  auto converged = [&](Sample const& s) {
+    return s.size() >= 2
+        && (!(rule.mean_error > 0.) || s.mean_error() <= rule.mean_error)
+        && (!(rule.std_dev_error > 0.)
+            || s.std_dev_error() <= rule.std_dev_error);
+  };
+
+  std::size_t const batch{rule.batch == 0 ? DEFAULT_BATCH_CHUNKS
+                                          : n_chunks(rule.batch)};
+  std::size_t const total{n_chunks(n)};
+  SequentialResult out;
+  for (std::size_t first{0}; first < total && !out.converged; first += batch) {
+    std::size_t const last{std::min(first + batch, total)};
+    simulate_chunks(barrier_up, barrier_down, unfolding, nullptr, y_dist,
+                    initial, n, first, last, pool, out.result);
+    out.result.n_generated = std::min(n, last * CHUNK_SIZE);
+    out.converged = converged(out.result.y) && converged(out.result.theta);
+  }
+
+  out.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  return out;
+}
+
+void simulate_exits(Barrier const& barrier_up, Barrier const& barrier_down,
+                    Beam const& beam, std::size_t n, std::uint64_t seed,
+                    ThreadPool& pool,
+                    std::function<void(std::vector<Exit> const&)> const& sink,
+                    Sampling sampling)
+{
+  // chunks are simulated in waves, so that memory use does not grow with n
+  std::size_t const wave_size{4 * std::size_t{pool.size()}};
+  std::vector<std::vector<Exit>> buffers(wave_size);
+  for (auto& b : buffers) {
+    b.reserve(CHUNK_SIZE);
+  }
+
+  std::size_t const total{n_chunks(n)};
+  auto const unfolding = Unfolding::make(barrier_up, barrier_down);
+  TruncatedNormal const y_dist{y0_distribution(barrier_up, beam)};
+  InitialConditions const initial{sampling, seed, beam, n};
+  for (std::size_t first{0}; first < total; first += wave_size) {
+    std::size_t const size{std::min(wave_size, total - first)};
+
+    pool.parallel_for(size, [&](std::size_t c) {
+      auto& buffer = buffers[c];
+      buffer.clear();
+      simulate_chunk(barrier_up, barrier_down, unfolding, nullptr, y_dist,
+                     initial, n, first + c,
+                     [&](double yf, double thetaf) {
+                       buffer.push_back({yf, thetaf});
+                     });
+    });
+
+    for (std::size_t c{0}; c != size; ++c) {
+      sink(buffers[c]);
+    }
+  }
+}
+
+std::vector<MonteCarloResult> simulate_sweep(std::span<Geometry const> points,
+                                             Beam const& beam, std::size_t n,
+                                             std::uint64_t seed,
+                                             ThreadPool& pool,
+                                             Sampling sampling)
+{
+  std::vector<std::optional<Unfolding>> unfoldings;
+  std::vector<TruncatedNormal> y_dists;
+  unfoldings.reserve(points.size());
+  y_dists.reserve(points.size());
+  for (auto const& p : points) {
+    unfoldings.push_back(Unfolding::make(p.barrier_up, p.barrier_down));
+    y_dists.push_back(y0_distribution(p.barrier_up, beam));
+  }
+
+  std::vector<MonteCarloResult> results(points.size());
+  for (auto& r : results) {
+    r.n_generated = n;
+  }
+  if (points.empty()) {
+    return results;
+  }
+
+  // the uniforms of y0 and the values of theta0 of a wave of chunks are
+  // sampled once, then every (chunk, point) pair is a task
+  std::size_t const wave_size{4 * std::size_t{pool.size()}};
+  std::vector<std::vector<double>> u_y(wave_size);
+  std::vector<std::vector<double>> theta0(wave_size);
+  std::vector<ChunkResult> chunk_results(wave_size * points.size());
+
+  std::size_t const total{n_chunks(n)};
+  InitialConditions const initial{sampling, seed, beam, n};
+  for (std::size_t first{0}; first < total; first += wave_size) {
+    std::size_t const size{std::min(wave_size, total - first)};
+
+    pool.parallel_for(size, [&](std::size_t c) {
+      std::size_t const begin{(first + c) * CHUNK_SIZE};
+      std::size_t const chunk_size{std::min(n, begin + CHUNK_SIZE) - begin};
+      u_y[c].resize(chunk_size);
+      theta0[c].resize(chunk_size);
+      initial(begin, u_y[c], theta0[c]);
+    });
+
+    pool.parallel_for(size * points.size(), [&](std::size_t task) {
+      std::size_t const c{task % size};
+      std::size_t const p{task / size};
+      ChunkResult& res = chunk_results[p * wave_size + c];
+      res = {};
+      std::array<double, BATCH> y0;
+      for (std::size_t b{0}; b < u_y[c].size(); b += BATCH) {
+        std::size_t const batch{std::min(BATCH, u_y[c].size() - b)};
+        std::copy_n(u_y[c].begin() + static_cast<std::ptrdiff_t>(b), batch,
+                    y0.begin());
+        y_dists[p](std::span{y0}.first(batch));
+        simulate_particles(points[p].barrier_up, points[p].barrier_down,
+                           unfoldings[p], nullptr,
+                           std::span{y0}.first(batch),
+                           std::span{theta0[c]}.subspan(b, batch),
+                           [&](double yf, double thetaf) {
+                             res.y.add(yf);
+                             res.theta.add(thetaf);
+                           });
+      }
+    });
+
+    // merge in chunk order, as simulate_n_particles
+    for (std::size_t p{0}; p != points.size(); ++p) {
+      for (std::size_t c{0}; c != size; ++c) {
+        results[p].y.merge(chunk_results[p * wave_size + c].y);
+        results[p].theta.merge(chunk_results[p * wave_size + c].theta);
+      }
+    }
+  }
+  return results;
+}
@@ -0,0 +1,158 @@
+#ifndef MONTECARLO_HPP
+#define MONTECARLO_HPP
+
+#include "kinematics.hpp"
+#include "statistics.hpp"
+#include "thread_pool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+class ExitMap;
+
+// parameters of the two gaussian distributions of the initial conditions, y0
+// being truncated to the inlet [-r1, r1]
+struct Beam
+{
+  double mu_y{0.};
+  double sigma_y{1.};
+  double mu_theta{0.};
+  double sigma_theta{3.};
+};
+
+// the initial conditions of the i-th particle are drawn from a counter-based
+// generator with counter i, so they only depend on (seed, i); particles are
+// simulated in chunks of CHUNK_SIZE, and the results do not depend on the
+// number of threads
+constexpr std::size_t CHUNK_SIZE{1 << 14};
+
+// pseudo_random: initial conditions from the Philox generator, statistics
+// converge as 1/sqrt(N); sobol: from a scrambled Sobol sequence (quasi Monte
+// Carlo), which converges faster for smooth observables such as the mean and
+// standard deviation of yf, at most 2^32 particles. Error estimates of sobol
+// runs come from independent runs with different seeds.
+enum class Sampling
+{
+  pseudo_random,
+  sobol
+};
+
+struct MonteCarloResult
+{
+  std::size_t n_generated{0};
+  // exit values of the particles exiting from the right side
+  Sample y;
+  Sample theta;
+};
+
+struct Exit
+{
+  double y;
+  double theta;
+};
+
+// linear barriers are simulated with the O(1) Unfolding engine, the others
+// with simulate_single_particle
+MonteCarloResult
+simulate_n_particles(Barrier const& barrier_up, Barrier const& barrier_down,
+                     Beam const& beam, std::size_t n, std::uint64_t seed,
+                     ThreadPool& pool,
+                     Sampling sampling = Sampling::pseudo_random);
+
+// as simulate_n_particles, but the exit state of each particle is
+// interpolated from exit_map where it has a value, and simulated elsewhere.
+// Throws if exit_map was built for different barriers.
+MonteCarloResult
+simulate_n_particles(ExitMap const& exit_map, Barrier const& barrier_up,
+                     Barrier const& barrier_down, Beam const& beam,
+                     std::size_t n, std::uint64_t seed, ThreadPool& pool,
+                     Sampling sampling = Sampling::pseudo_random);
+
+// comparison of an ExitMap with the exact engine on n particles of a beam
+struct ExitMapAccuracy
+{
+  std::size_t n{0};
+  // particles with a value in the map, i.e. not simulated
+  std::size_t served{0};
+  // served particles exiting from the wrong side
+  std::size_t misclassified{0};
+  // served particles exiting from the right side, in both
+  std::size_t n_compared{0};
+  // errors of yf and thetaf of the compared particles
+  double y_max_error{0.};
+  double y_rms_error{0.};
+  double theta_max_error{0.};
+  double theta_rms_error{0.};
+};
+
+// throws if exit_map was built for different barriers
+ExitMapAccuracy exit_map_accuracy(ExitMap const& exit_map,
+                                  Barrier const& barrier_up,
+                                  Barrier const& barrier_down,
+                                  Beam const& beam, std::size_t n,
+                                  std::uint64_t seed, ThreadPool& pool);
+
+// chunks per batch of simulate_until when StoppingRule::batch is 0; fixed, so
+// that the checks, and hence the result, do not depend on the thread count
+constexpr std::size_t DEFAULT_BATCH_CHUNKS{16};
+
+// targets of simulate_until: standard errors of the mean and of the standard
+// deviation, of both yf and thetaf; 0 for no target
+struct StoppingRule
+{
+  double mean_error{0.};
+  double std_dev_error{0.};
+  // particles simulated between two checks, rounded up to whole chunks; 0 for
+  // DEFAULT_BATCH_CHUNKS chunks, whatever the number of threads
+  std::size_t batch{0};
+  // the run stops here even if the targets are not met
+  std::size_t max_particles{std::size_t{1} << 32};
+};
+
+struct SequentialResult
+{
+  MonteCarloResult result;
+  bool converged{false};
+  // wall time of the run
+  double seconds{0.};
+};
+
+// simulates batches of particles in parallel until the targets of rule are
+// met, checked on the merged Sample of all the particles after each batch; the
+// result is the one of simulate_n_particles with the same seed and
+// n = result.n_generated. Throws if rule has no target.
+SequentialResult simulate_until(Barrier const& barrier_up,
+                                Barrier const& barrier_down, Beam const& beam,
+                                StoppingRule const& rule, std::uint64_t seed,
+                                ThreadPool& pool);
+
+// calls sink once per chunk, in chunk order, with the exit values of the
+// particles of that chunk exiting from the right side
+void simulate_exits(Barrier const& barrier_up, Barrier const& barrier_down,
+                    Beam const& beam, std::size_t n, std::uint64_t seed,
+                    ThreadPool& pool,
+                    std::function<void(std::vector<Exit> const&)> const& sink,
+                    Sampling sampling = Sampling::pseudo_random);
+
+// barriers of a point of a parameter sweep
+struct Geometry
+{
+  Barrier barrier_up;
+  Barrier barrier_down;
+};
+
+// simulates the same particles through every geometry, with common random
+// numbers: theta0 and the uniforms of y0 are sampled once per particle and
+// shared by all the points, y0 being obtained by inversion of the y0
+// distribution of each point, truncated to its inlet. The differences between
+// points then have a much smaller variance than with independent runs, and the
+// result of each point is the one of simulate_n_particles with the same seed.
+// (chunk, point) pairs are simulated in parallel.
+std::vector<MonteCarloResult>
+simulate_sweep(std::span<Geometry const> points, Beam const& beam,
+               std::size_t n, std::uint64_t seed, ThreadPool& pool,
+               Sampling sampling = Sampling::pseudo_random);
+
+#endif
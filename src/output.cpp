@@ -0,0 +1,384 @@
+#include "output.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+// values are copied as they are in memory
+static_assert(std::endian::native == std::endian::little,
+              "the binary output is little endian");
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC{'B', 'I', 'L', 'I', 'A', 'R', 'D', 'O'};
+constexpr std::uint32_t VERSION{1};
+
+template<typename T>
+void read_value(std::ifstream& file, T& value)
+{
+  file.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+BinaryWriter::BinaryWriter(std::string const& path, RunInfo const& info,
+                           Precision precision)
+    : file_{path, std::ios::binary}
+    , precision_{precision}
+{
+  if (!file_) {
+    throw std::runtime_error{"Cannot open " + path};
+  }
+  buffer_.reserve(BUFFER_SIZE);
+
+  append(MAGIC.data(), MAGIC.size());
+  append(&VERSION, sizeof(VERSION));
+  append(&precision_, sizeof(precision_));
+  for (double x : {info.r1, info.r2, info.l, info.beam.mu_y,
+                   info.beam.sigma_y, info.beam.mu_theta,
+                   info.beam.sigma_theta}) {
+    append(&x, sizeof(x));
+  }
+  append(&info.n_particles, sizeof(info.n_particles));
+  append(&info.seed, sizeof(info.seed));
+}
+
+BinaryWriter::~BinaryWriter()
+{
+  if (file_.is_open()) {
+    try {
+      close();
+    } catch (...) {
+      // errors can only be reported by an explicit close()
+    }
+  }
+}
+
+void BinaryWriter::append(void const* data, std::size_t size)
+{
+  auto const bytes = static_cast<char const*>(data);
+  buffer_.insert(buffer_.end(), bytes, bytes + size);
+}
+
+void BinaryWriter::flush()
+{
+  file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  buffer_.clear();
+  if (!file_) {
+    throw std::runtime_error{"Error writing the binary output"};
+  }
+}
+
+void BinaryWriter::write(std::span<Exit const> exits)
+{
+  std::uint64_t const n{exits.size()};
+  std::size_t const value_size{static_cast<std::size_t>(precision_)};
+  if (buffer_.size() + sizeof(n) + 2 * n * value_size > BUFFER_SIZE) {
+    flush();
+  }
+
+  append(&n, sizeof(n));
+  // columns are converted in place, at the end of the buffer
+  std::size_t const column{buffer_.size()};
+  buffer_.resize(column + 2 * n * value_size);
+  char* const yf{buffer_.data() + column};
+  char* const thetaf{yf + n * value_size};
+  for (std::size_t i{0}; i != n; ++i) {
+    if (precision_ == Precision::float32) {
+      float const y{static_cast<float>(exits[i].y)};
+      float const theta{static_cast<float>(exits[i].theta)};
+      std::memcpy(yf + i * value_size, &y, sizeof(y));
+      std::memcpy(thetaf + i * value_size, &theta, sizeof(theta));
+    } else {
+      std::memcpy(yf + i * value_size, &exits[i].y, sizeof(double));
+      std::memcpy(thetaf + i * value_size, &exits[i].theta, sizeof(double));
+    }
+  }
+
+  if (buffer_.size() >= BUFFER_SIZE) {
+    flush();
+  }
+}
+
+void BinaryWriter::close()
+{
+  flush();
+  file_.close();
+  if (!file_) {
+    throw std::runtime_error{"Error closing the binary output"};
+  }
+}
+
+CsvWriter::CsvWriter(std::string const& path, std::string delimiter,
+                     int precision)
+    : file_{path, std::ios::binary}
+    , delimiter_{std::move(delimiter)}
+    , precision_{precision}
+    , buffer_(BUFFER_SIZE)
+{
+  if (precision_ < 0 || precision_ > 17) {
+    throw std::invalid_argument{"The csv precision must be in [0, 17]"};
+  }
+  if (delimiter_.size() > BUFFER_SIZE / 2) {
+    throw std::invalid_argument{"The csv delimiter is too long"};
+  }
+  if (!file_) {
+    throw std::runtime_error{"Cannot open " + path};
+  }
+}
+
+CsvWriter::~CsvWriter()
+{
+  if (file_.is_open()) {
+    try {
+      close();
+    } catch (...) {
+      // errors can only be reported by an explicit close()
+    }
+  }
+}
+
+void CsvWriter::append(double value)
+{
+  char* const first{buffer_.data() + size_};
+  char* const last{first + MAX_VALUE_SIZE};
+  auto const result = precision_ == 0
+                        ? std::to_chars(first, last, value)
+                        : std::to_chars(first, last, value,
+                                        std::chars_format::general, precision_);
+  size_ = static_cast<std::size_t>(result.ptr - buffer_.data());
+}
+
+void CsvWriter::flush()
+{
+  file_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+  size_ = 0;
+  if (!file_) {
+    throw std::runtime_error{"Error writing the csv output"};
+  }
+}
+
+void CsvWriter::write(std::span<Exit const> exits)
+{
+  std::size_t const max_line_size{2 * MAX_VALUE_SIZE + delimiter_.size() + 1};
+  for (auto const& e : exits) {
+    if (size_ + max_line_size > BUFFER_SIZE) {
+      flush();
+    }
+    append(e.y);
+    std::copy(delimiter_.begin(), delimiter_.end(), buffer_.data() + size_);
+    size_ += delimiter_.size();
+    append(e.theta);
+    buffer_[size_++] = '\n';
+  }
+}
+
+void CsvWriter::close()
+{
+  flush();
+  file_.close();
+  if (!file_) {
+    throw std::runtime_error{"Error closing the csv output"};
+  }
+}
+
+AsyncWriter::AsyncWriter(std::function<void(std::span<Exit const>)> write,
+                         std::size_t n_buffers)
+    : write_{std::move(write)}
+    , buffers_(n_buffers)
+    , queue_(n_buffers)
+{
+  if (n_buffers == 0) {
+    throw std::invalid_argument{"AsyncWriter needs at least one buffer"};
+  }
+  free_.reserve(n_buffers);
+  for (std::size_t i{0}; i != n_buffers; ++i) {
+    free_.push_back(i);
+  }
+  thread_ = std::jthread{[this] { work(); }};
+}
+
+AsyncWriter::~AsyncWriter()
+{
+  if (thread_.joinable()) {
+    try {
+      close();
+    } catch (...) {
+      // errors can only be reported by an explicit close()
+    }
+  }
+}
+
+void AsyncWriter::work()
+{
+  using Clock = std::chrono::steady_clock;
+  std::unique_lock lock{m_};
+  for (;;) {
+    if (n_queued_ == 0 && !done_) {
+      auto const start = Clock::now();
+      cv_.wait(lock, [&] { return n_queued_ != 0 || done_; });
+      ++stats_.n_empty;
+      stats_.empty_seconds +=
+          std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    if (n_queued_ == 0) {
+      return;
+    }
+
+    std::size_t const index{queue_[head_]};
+    lock.unlock();
+    try {
+      write_(buffers_[index]);
+    } catch (...) {
+      lock.lock();
+      error_ = std::current_exception();
+      cv_.notify_all();
+      return;
+    }
+    lock.lock();
+
+    head_ = (head_ + 1) % queue_.size();
+    --n_queued_;
+    free_.push_back(index);
+    cv_.notify_all();
+  }
+}
+
+void AsyncWriter::push(std::span<Exit const> exits)
+{
+  using Clock = std::chrono::steady_clock;
+  std::unique_lock lock{m_};
+  if (free_.empty() && !error_) {
+    auto const start = Clock::now();
+    cv_.wait(lock, [&] { return !free_.empty() || error_; });
+    ++stats_.n_full;
+    stats_.full_seconds +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+  }
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  assert(!done_);
+
+  std::size_t const index{free_.back()};
+  free_.pop_back();
+  lock.unlock();
+  // the capacity of the buffers is kept, after the first chunks they are
+  // not reallocated
+  buffers_[index].assign(exits.begin(), exits.end());
+  lock.lock();
+
+  queue_[(head_ + n_queued_) % queue_.size()] = index;
+  ++n_queued_;
+  ++stats_.n_chunks;
+  stats_.max_queued = std::max(stats_.max_queued, n_queued_);
+  cv_.notify_all();
+}
+
+void AsyncWriter::close()
+{
+  {
+    std::lock_guard lock{m_};
+    done_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+WriterStats AsyncWriter::stats()
+{
+  std::lock_guard lock{m_};
+  return stats_;
+}
+
+BinaryReader::BinaryReader(std::string const& path)
+    : file_{path, std::ios::binary}
+{
+  if (!file_) {
+    throw std::runtime_error{"Cannot open " + path};
+  }
+  file_.seekg(0, std::ios::end);
+  size_ = static_cast<std::uint64_t>(file_.tellg());
+  file_.seekg(0);
+
+  std::array<char, 8> magic{};
+  std::uint32_t version{0};
+  file_.read(magic.data(), magic.size());
+  read_value(file_, version);
+  read_value(file_, precision_);
+  for (double* x : {&info_.r1, &info_.r2, &info_.l, &info_.beam.mu_y,
+                    &info_.beam.sigma_y, &info_.beam.mu_theta,
+                    &info_.beam.sigma_theta}) {
+    read_value(file_, *x);
+  }
+  read_value(file_, info_.n_particles);
+  read_value(file_, info_.seed);
+
+  if (!file_ || magic != MAGIC || version != VERSION
+      || (precision_ != Precision::float32
+          && precision_ != Precision::float64)) {
+    throw std::runtime_error{path + " is not a valid binary output"};
+  }
+}
+
+RunInfo const& BinaryReader::info() const
+{
+  return info_;
+}
+
+Precision BinaryReader::precision() const
+{
+  return precision_;
+}
+
+bool BinaryReader::read(std::vector<Exit>& exits)
+{
+  exits.clear();
+  std::uint64_t n{0};
+  read_value(file_, n);
+  if (file_.eof() && file_.gcount() == 0) {
+    return false;
+  }
+  if (!file_) {
+    throw std::runtime_error{"Truncated chunk in the binary output"};
+  }
+
+  // n is not trusted before it is checked against the rest of the file
+  std::size_t const value_size{static_cast<std::size_t>(precision_)};
+  auto const left = size_ - static_cast<std::uint64_t>(file_.tellg());
+  if (n > left / (2 * value_size)) {
+    throw std::runtime_error{"Truncated chunk in the binary output"};
+  }
+  std::vector<char> columns(2 * n * value_size);
+  file_.read(columns.data(), static_cast<std::streamsize>(columns.size()));
+  if (!file_) {
+    throw std::runtime_error{"Truncated chunk in the binary output"};
+  }
+
+  exits.resize(n);
+  char const* const yf{columns.data()};
+  char const* const thetaf{yf + n * value_size};
+  for (std::size_t i{0}; i != n; ++i) {
+    if (precision_ == Precision::float32) {
+      float y;
+      float theta;
+      std::memcpy(&y, yf + i * value_size, value_size);
+      std::memcpy(&theta, thetaf + i * value_size, value_size);
+      exits[i] = {y, theta};
+    } else {
+      std::memcpy(&exits[i].y, yf + i * value_size, value_size);
+      std::memcpy(&exits[i].theta, thetaf + i * value_size, value_size);
+    }
+  }
+  return true;
+}
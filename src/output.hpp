@@ -0,0 +1,181 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include "montecarlo.hpp"
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// parameters of a run of multiple_particle_sim_csv, stored in the header of
+// the binary output
+struct RunInfo
+{
+  double r1{0.};
+  double r2{0.};
+  double l{0.};
+  Beam beam{};
+  std::uint64_t n_particles{0};
+  std::uint64_t seed{0};
+};
+
+// width of the values stored in the binary output
+enum class Precision : std::uint32_t
+{
+  float32 = 4,
+  float64 = 8
+};
+
+// binary columnar format, little endian:
+//   header  "BILIARDO", version (uint32), Precision (uint32),
+//           r1, r2, l, mu_y, sigma_y, mu_theta, sigma_theta (float64),
+//           n_particles, seed (uint64)
+//   chunks  n (uint64), n values of yf, n values of thetaf
+// each call to write appends a chunk; chunks are collected in a large buffer
+// and written with few big writes
+class BinaryWriter
+{
+  std::ofstream file_;
+  Precision precision_;
+  std::vector<char> buffer_;
+
+  void append(void const* data, std::size_t size);
+  void flush();
+
+ public:
+  static constexpr std::size_t BUFFER_SIZE{8 << 20};
+
+  // throws if the file cannot be opened
+  BinaryWriter(std::string const& path, RunInfo const& info,
+               Precision precision = Precision::float64);
+  ~BinaryWriter();
+
+  BinaryWriter(BinaryWriter const&)            = delete;
+  BinaryWriter& operator=(BinaryWriter const&) = delete;
+
+  void write(std::span<Exit const> exits);
+  // flushes the buffer and closes the file, throws on write errors
+  void close();
+};
+
+// csv output, one "yf<delimiter>thetaf" line per exit; values are formatted
+// with std::to_chars into a large buffer, written with few big writes
+class CsvWriter
+{
+  std::ofstream file_;
+  std::string delimiter_;
+  int precision_;
+  std::vector<char> buffer_;
+  std::size_t size_{0};
+
+  void append(double value);
+  void flush();
+
+ public:
+  static constexpr std::size_t BUFFER_SIZE{8 << 20};
+  // longest value formatted by append, e.g. -1.2345678901234567e-308
+  static constexpr std::size_t MAX_VALUE_SIZE{24};
+
+  // precision 0 gives the shortest representation that is read back exactly,
+  // otherwise precision is the number of significant digits, at most 17;
+  // throws if the file cannot be opened or the arguments are invalid
+  CsvWriter(std::string const& path, std::string delimiter = ", ",
+            int precision = 0);
+  ~CsvWriter();
+
+  CsvWriter(CsvWriter const&)            = delete;
+  CsvWriter& operator=(CsvWriter const&) = delete;
+
+  void write(std::span<Exit const> exits);
+  // flushes the buffer and closes the file, throws on write errors
+  void close();
+};
+
+// back-pressure statistics of an AsyncWriter
+struct WriterStats
+{
+  std::uint64_t n_chunks{0};
+  // times push waited for a free buffer, i.e. the output was slower than the
+  // simulation, and total time spent waiting
+  std::uint64_t n_full{0};
+  double full_seconds{0.};
+  // times the writer thread waited for a chunk, and total time spent waiting
+  std::uint64_t n_empty{0};
+  double empty_seconds{0.};
+  // largest number of chunks waiting to be written
+  std::size_t max_queued{0};
+};
+
+// writes chunks of exits on a background thread, so that the simulation does
+// not wait for the output: push copies a chunk into a free buffer of a fixed
+// pool and queues it, the thread passes the queued buffers to write, in push
+// order, and gives them back to the pool; push blocks while every buffer is
+// queued
+class AsyncWriter
+{
+  std::function<void(std::span<Exit const>)> write_;
+  std::vector<std::vector<Exit>> buffers_;
+  // indices in buffers_: the free ones, and the queued ones, a ring of
+  // n_queued_ elements starting at head_
+  std::vector<std::size_t> free_;
+  std::vector<std::size_t> queue_;
+  std::size_t head_{0};
+  std::size_t n_queued_{0};
+
+  std::mutex m_;
+  std::condition_variable cv_;
+  bool done_{false};
+  std::exception_ptr error_;
+  WriterStats stats_;
+  std::jthread thread_;
+
+  void work();
+
+ public:
+  // write is called on the background thread
+  explicit AsyncWriter(std::function<void(std::span<Exit const>)> write,
+                       std::size_t n_buffers = 4);
+  ~AsyncWriter();
+
+  AsyncWriter(AsyncWriter const&)            = delete;
+  AsyncWriter& operator=(AsyncWriter const&) = delete;
+
+  // rethrows the first exception thrown by write
+  void push(std::span<Exit const> exits);
+  // waits until every queued chunk is written and stops the thread; rethrows
+  // the first exception thrown by write
+  void close();
+
+  // complete only after close
+  WriterStats stats();
+};
+
+// reads back the files of BinaryWriter
+class BinaryReader
+{
+  std::ifstream file_;
+  // bytes in the file, which bound the size of a chunk
+  std::uint64_t size_{0};
+  Precision precision_;
+  RunInfo info_;
+
+ public:
+  // throws if the file cannot be opened or is not a valid binary output
+  explicit BinaryReader(std::string const& path);
+
+  RunInfo const& info() const;
+  Precision precision() const;
+
+  // replaces the content of exits with the next chunk, returns false at the
+  // end of the file; throws if the chunk is truncated
+  bool read(std::vector<Exit>& exits);
+};
+
+#endif
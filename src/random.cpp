@@ -0,0 +1,230 @@
+#include "random.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// standard normal cumulative distribution function
+double normal_cdf(double x)
+{
+  return 0.5 * std::erfc(-x / std::numbers::sqrt2);
+}
+
+// |p - 0.5| <= CENTRAL is the central region of Wichura's approximation
+constexpr double CENTRAL{0.425};
+
+// central region of Wichura's PPND16 (Applied Statistics algorithm AS241,
+// 1988), q = p - 0.5: relative error below 1e-16, and only additions,
+// multiplications and one division, so that loops over it are vectorised
+double wichura_central(double q)
+{
+  double const r{0.180625 - q * q};
+  return q
+       * (((((((2.5090809287301226727e+03 * r + 3.3430575583588128105e+04) * r
+               + 6.7265770927008700853e+04)
+                  * r
+              + 4.5921953931549871457e+04)
+                 * r
+             + 1.3731693765509461125e+04)
+                * r
+            + 1.9715909503065514427e+03)
+               * r
+           + 1.3314166789178437745e+02)
+              * r
+          + 3.3871328727963666080e+00)
+       / (((((((5.2264952788528545610e+03 * r + 2.8729085735721942674e+04) * r
+               + 3.9307895800092710610e+04)
+                  * r
+              + 2.1213794301586595867e+04)
+                 * r
+             + 5.3941960214247511077e+03)
+                * r
+            + 6.8718700749205790830e+02)
+               * r
+           + 4.2313330701600911252e+01)
+              * r
+          + 1.);
+}
+
+// tails of Wichura's PPND16, p < 0.075: r = sqrt(-log(p)), the value for p
+// being -wichura_tail(r)
+double wichura_tail(double r)
+{
+  if (r <= 5.) {
+    r -= 1.6;
+    return (((((((7.74545014278341407640e-04 * r + 2.27238449892691845833e-02)
+                     * r
+                 + 2.41780725177450611770e-01)
+                    * r
+                + 1.27045825245236838258e+00)
+                   * r
+               + 3.64784832476320460504e+00)
+                  * r
+              + 5.76949722146069140550e+00)
+                 * r
+             + 4.63033784615654529590e+00)
+                * r
+            + 1.42343711074968357734e+00)
+         / (((((((1.05075007164441684324e-09 * r + 5.47593808499534494600e-04)
+                     * r
+                 + 1.51986665636164571966e-02)
+                    * r
+                + 1.48103976427480074590e-01)
+                   * r
+               + 6.89767334985100004550e-01)
+                  * r
+              + 1.67638483018380384940e+00)
+                 * r
+             + 2.05319162663775882187e+00)
+                * r
+            + 1.);
+  }
+  r -= 5.;
+  return (((((((2.01033439929228813265e-07 * r + 2.71155556874348757815e-05)
+                   * r
+               + 1.24266094738807843860e-03)
+                  * r
+              + 2.65321895265761230930e-02)
+                 * r
+             + 2.96560571828504891230e-01)
+                * r
+            + 1.78482653991729133580e+00)
+               * r
+           + 5.46378491116411436990e+00)
+              * r
+          + 6.65790464350110377720e+00)
+       / (((((((2.04426310338993978564e-15 * r + 1.42151175831644588870e-07)
+                   * r
+               + 1.84631831751005468180e-05)
+                  * r
+              + 7.86869131145613259100e-04)
+                 * r
+             + 1.48753612908506148525e-02)
+                * r
+            + 1.36929880922735805310e-01)
+               * r
+           + 5.99832206555887937690e-01)
+              * r
+          + 1.);
+}
+
+} // namespace
+
+double inverse_normal_cdf(double p)
+{
+  if (p <= 0.) {
+    return -std::numeric_limits<double>::infinity();
+  }
+  if (p >= 1.) {
+    return std::numeric_limits<double>::infinity();
+  }
+  double const q{p - 0.5};
+  if (std::abs(q) <= CENTRAL) {
+    return wichura_central(q);
+  }
+  // 1 - p is exact for p > 0.5
+  double const x{wichura_tail(std::sqrt(-std::log(q < 0. ? p : 1. - p)))};
+  return q < 0. ? -x : x;
+}
+
+void inverse_normal_cdf(std::span<double> p)
+{
+  // the tails are recomputed after the vectorised loop, which needs the
+  // values of p of a block
+  constexpr std::size_t BLOCK{64};
+  std::array<double, BLOCK> x;
+  for (std::size_t first{0}; first < p.size(); first += BLOCK) {
+    std::span<double> const b{
+        p.subspan(first, std::min(BLOCK, p.size() - first))};
+    for (std::size_t j{0}; j != b.size(); ++j) {
+      x[j] = wichura_central(b[j] - 0.5);
+    }
+    for (std::size_t j{0}; j != b.size(); ++j) {
+      b[j] = std::abs(b[j] - 0.5) <= CENTRAL ? x[j] : inverse_normal_cdf(b[j]);
+    }
+  }
+}
+
+TruncatedNormal::TruncatedNormal(double mu, double sigma, double lo, double hi)
+    : mu_{mu}
+    , sigma_{sigma}
+    , lo_{lo}
+    , hi_{hi}
+{
+  if (!(sigma > 0.) || !(lo < hi)) {
+    throw std::invalid_argument{
+        "Truncated normal needs sigma > 0 and lo < hi"};
+  }
+  double a{(lo - mu) / sigma};
+  double b{(hi - mu) / sigma};
+  mirrored_ = a > 0.;
+  if (mirrored_) {
+    a = -std::exchange(b, -a);
+  }
+  p_lo_    = normal_cdf(a);
+  p_range_ = normal_cdf(b) - p_lo_;
+  if (!(p_range_ > 0.)) {
+    throw std::runtime_error{"Truncation interval has zero probability"};
+  }
+}
+
+double TruncatedNormal::operator()(double u) const
+{
+  double const x{inverse_normal_cdf(p_lo_ + u * p_range_)};
+  return std::clamp(mu_ + sigma_ * (mirrored_ ? -x : x), lo_, hi_);
+}
+
+void TruncatedNormal::operator()(std::span<double> u) const
+{
+  for (double& x : u) {
+    x = p_lo_ + x * p_range_;
+  }
+  inverse_normal_cdf(u);
+  for (double& x : u) {
+    x = std::clamp(mu_ + sigma_ * (mirrored_ ? -x : x), lo_, hi_);
+  }
+}
+
+void fill_uniform(Philox const& gen, std::uint64_t stream, std::uint64_t first,
+                  std::span<double> out)
+{
+  for (std::size_t j{0}; j < out.size(); ++j) {
+    out[j] = to_unit(gen(first + j, stream));
+  }
+}
+
+void fill_normal(Philox const& gen, std::uint64_t stream, std::uint64_t first,
+                 double mu, double sigma, std::span<double> out)
+{
+  fill_uniform(gen, stream, first, out);
+  inverse_normal_cdf(out);
+  for (double& x : out) {
+    x = mu + sigma * x;
+  }
+}
+
+void fill_truncated_normal(Philox const& gen, std::uint64_t stream,
+                           std::uint64_t first, TruncatedNormal const& dist,
+                           std::span<double> out)
+{
+  fill_uniform(gen, stream, first, out);
+  dist(out);
+}
+
+void fill_sobol(Sobol const& gen, std::uint64_t first, std::span<double> u0,
+                std::span<double> u1)
+{
+  if (u0.size() != u1.size() || first + u0.size() > std::uint64_t{1} << 32) {
+    throw std::invalid_argument{"Invalid range of the Sobol sequence"};
+  }
+  for (std::size_t j{0}; j < u0.size(); ++j) {
+    Sobol::Point const p{gen(static_cast<std::uint32_t>(first + j))};
+    u0[j] = to_unit(p[0]);
+    u1[j] = to_unit(p[1]);
+  }
+}
@@ -0,0 +1,176 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// counter-based generator Philox4x32-10 (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3", 2011): every block of 128 random bits is a
+// pure function of (seed, stream, counter), so any element of any stream can
+// be computed directly, in any order and on any thread
+class Philox
+{
+  std::array<std::uint32_t, 2> key_;
+
+ public:
+  using Block = std::array<std::uint32_t, 4>;
+
+  constexpr explicit Philox(std::uint64_t seed)
+      : key_{static_cast<std::uint32_t>(seed),
+             static_cast<std::uint32_t>(seed >> 32)}
+  {}
+
+  constexpr Block operator()(std::uint64_t counter,
+                             std::uint64_t stream = 0) const
+  {
+    Block ctr{static_cast<std::uint32_t>(counter),
+              static_cast<std::uint32_t>(counter >> 32),
+              static_cast<std::uint32_t>(stream),
+              static_cast<std::uint32_t>(stream >> 32)};
+    std::uint32_t k0{key_[0]};
+    std::uint32_t k1{key_[1]};
+    for (int round{0}; round != 10; ++round) {
+      std::uint64_t const p0{std::uint64_t{0xD2511F53} * ctr[0]};
+      std::uint64_t const p1{std::uint64_t{0xCD9E8D57} * ctr[2]};
+      ctr = {static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ k0,
+             static_cast<std::uint32_t>(p1),
+             static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ k1,
+             static_cast<std::uint32_t>(p0)};
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+    return ctr;
+  }
+};
+
+// uniform double in (0, 1), never 0 or 1, from the first 52 bits of a block:
+// k is put in the mantissa of 1 + k / 2^52, then (2k + 1) / 2^53 is computed
+// exactly, without integer to floating point conversions (which cannot be
+// vectorised before AVX-512)
+constexpr double to_unit(Philox::Block const& b)
+{
+  std::uint64_t const bits{b[0] | std::uint64_t{b[1]} << 32};
+  double const one_k{
+      std::bit_cast<double>(bits >> 12 | std::uint64_t{0x3FF0000000000000})};
+  return one_k - (1. - 0x1p-53);
+}
+
+// two-dimensional Sobol sequence, Owen scrambled with the hash-based nested
+// uniform scrambling of Burley ("Practical hash-based Owen scrambling", 2020):
+// the first 2^m points still have one point in each elementary interval of
+// area 2^-m, so smooth integrands converge much faster than 1/sqrt(N), while
+// the estimates are unbiased and independent between seeds. As for Philox, the
+// i-th point is a pure function of (seed, i).
+class Sobol
+{
+  std::array<std::uint32_t, 2> seeds_;
+
+  static constexpr std::uint32_t reverse_bits(std::uint32_t x)
+  {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+    x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+    x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+    x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+    return x;
+  }
+
+  // random permutation of the bits of x, each bit depending only on the less
+  // significant ones (Laine and Karras, improved by Burley); with the bits
+  // reversed it is a nested uniform scramble
+  static constexpr std::uint32_t permute(std::uint32_t x, std::uint32_t seed)
+  {
+    x ^= x * 0x3d20adea;
+    x += seed;
+    x *= (seed >> 16) | 1;
+    x ^= x * 0x05526c56;
+    x ^= x * 0x53a22864;
+    return x;
+  }
+
+ public:
+  using Point = std::array<std::uint32_t, 2>;
+
+  constexpr explicit Sobol(std::uint64_t seed)
+      : seeds_{Philox{seed}(0)[0], Philox{seed}(0)[1]}
+  {}
+
+  constexpr Point operator()(std::uint32_t index) const
+  {
+    // first dimension: van der Corput sequence in base 2, i.e. the bits of
+    // index reversed; second one: direction numbers of the polynomial x + 1
+    std::uint32_t x1{0};
+    std::uint32_t v{0x80000000};
+    for (std::uint32_t i{index}; i != 0; i >>= 1) {
+      if (i & 1) {
+        x1 ^= v;
+      }
+      v ^= v >> 1;
+    }
+    return {reverse_bits(permute(index, seeds_[0])),
+            reverse_bits(permute(reverse_bits(x1), seeds_[1]))};
+  }
+};
+
+// uniform double in (0, 1) from 32 bits: (x + 1/2) / 2^32
+constexpr double to_unit(std::uint32_t x)
+{
+  return (static_cast<double>(x) + 0.5) * 0x1p-32;
+}
+
+// inverse of the standard normal cumulative distribution function, p in
+// (0, 1): the rational approximations of Wichura (AS241), accurate to a few
+// ulps; in the central region |p - 0.5| <= 0.425 without branches or calls
+double inverse_normal_cdf(double p);
+
+// p[j] = inverse_normal_cdf(p[j]): the central region, where most of the
+// values are, is computed by a vectorised loop and only the tails one by one
+void inverse_normal_cdf(std::span<double> p);
+
+// normal distribution N(mu, sigma) truncated to [lo, hi], sampled by
+// inversion: one uniform gives one value, without rejections, however small
+// the probability of [lo, hi]
+class TruncatedNormal
+{
+  double mu_;
+  double sigma_;
+  double lo_;
+  double hi_;
+  // when [lo, hi] is in the right tail the mirrored distribution is sampled,
+  // where the cdf does not lose precision
+  bool mirrored_;
+  double p_lo_;
+  double p_range_;
+
+ public:
+  // throws if sigma <= 0, lo >= hi or [lo, hi] has zero probability
+  TruncatedNormal(double mu, double sigma, double lo, double hi);
+
+  // u uniform in (0, 1)
+  double operator()(double u) const;
+  // u[j] = (*this)(u[j]), vectorised as inverse_normal_cdf
+  void operator()(std::span<double> u) const;
+};
+
+// out[j] = to_unit(gen(first + j, stream)): the loop is vectorised
+void fill_uniform(Philox const& gen, std::uint64_t stream, std::uint64_t first,
+                  std::span<double> out);
+
+// out[j] = mu + sigma * inverse_normal_cdf(u_j), u_j as in fill_uniform
+void fill_normal(Philox const& gen, std::uint64_t stream, std::uint64_t first,
+                 double mu, double sigma, std::span<double> out);
+
+// out[j] = dist(u_j), u_j as in fill_uniform
+void fill_truncated_normal(Philox const& gen, std::uint64_t stream,
+                           std::uint64_t first, TruncatedNormal const& dist,
+                           std::span<double> out);
+
+// u0[j], u1[j] = to_unit of the coordinates of gen(first + j); throws if the
+// points are beyond the 2^32 of the sequence
+void fill_sobol(Sobol const& gen, std::uint64_t first, std::span<double> u0,
+                std::span<double> u1);
+
+#endif
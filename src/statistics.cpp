@@ -1,25 +1,139 @@
 #include "statistics.hpp"
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <limits>
+#include <numeric>
 #include <stdexcept>
 
+namespace {
+
+// independent accumulators of add_block, which gcc can keep in vector
+// registers without reassociating the sums
+constexpr std::size_t LANES{8};
+// entries whose moments are computed together by add(std::span)
+constexpr std::size_t BLOCK{1024};
+
+} // namespace
+
 Sample::Sample()
     : n{0}
-    , s1{0}
-    , s2{0}
-    , s3{0}
-    , s4{0}
+    , mean{0}
+    , m2{0}
+    , m3{0}
+    , m4{0}
+{}
+
+Sample::Sample(std::int64_t count, double avg, double sum2, double sum3,
+               double sum4)
+    : n{count}
+    , mean{avg}
+    , m2{sum2}
+    , m3{sum3}
+    , m4{sum4}
 {}
 
 void Sample::add(double x)
 {
+  double const n1    = static_cast<double>(n);
   ++n;
-  s1 += x;
-  s2 += x * x;
-  s3 += std::pow(x, 3);
-  s4 += std::pow(x, 4);
+  double const N     = static_cast<double>(n);
+  double const delta = x - mean;
+  double const dn    = delta / N;
+  double const dn2   = dn * dn;
+  double const term  = delta * dn * n1;
+
+  mean += dn;
+  m4 += term * dn2 * (N * N - 3 * N + 3) + 6 * dn2 * m2 - 4 * dn * m3;
+  m3 += term * dn * (N - 2) - 3 * dn * m2;
+  m2 += term;
+}
+
+void Sample::add(std::span<double const> xs)
+{
+  for (std::size_t first{0}; first < xs.size(); first += BLOCK) {
+    add_block(xs.subspan(first, std::min(BLOCK, xs.size() - first)));
+  }
+}
+
+void Sample::add_block(std::span<double const> xs)
+{
+  std::size_t const size = xs.size();
+  std::size_t const body = size / LANES * LANES;
+
+  std::array<double, LANES> s1{};
+  for (std::size_t i{0}; i != body; i += LANES) {
+    for (std::size_t k{0}; k != LANES; ++k) {
+      s1[k] += xs[i + k];
+    }
+  }
+  for (std::size_t i{body}; i != size; ++i) {
+    s1[0] += xs[i];
+  }
+  double const N = static_cast<double>(size);
+  double const block_mean =
+      std::accumulate(s1.begin(), s1.end(), 0.) / N;
+
+  std::array<double, LANES> s2{};
+  std::array<double, LANES> s3{};
+  std::array<double, LANES> s4{};
+  for (std::size_t i{0}; i != body; i += LANES) {
+    for (std::size_t k{0}; k != LANES; ++k) {
+      double const d  = xs[i + k] - block_mean;
+      double const d2 = d * d;
+      s2[k] += d2;
+      s3[k] += d2 * d;
+      s4[k] += d2 * d2;
+    }
+  }
+  for (std::size_t i{body}; i != size; ++i) {
+    double const d  = xs[i] - block_mean;
+    double const d2 = d * d;
+    s2[0] += d2;
+    s3[0] += d2 * d;
+    s4[0] += d2 * d2;
+  }
+
+  merge(Sample{static_cast<std::int64_t>(size), block_mean,
+               std::accumulate(s2.begin(), s2.end(), 0.),
+               std::accumulate(s3.begin(), s3.end(), 0.),
+               std::accumulate(s4.begin(), s4.end(), 0.)});
 }
 
-int Sample::size()
+void Sample::merge(Sample const& other)
+{
+  if (other.n == 0) {
+    return;
+  }
+  if (n == 0) {
+    *this = other;
+    return;
+  }
+
+  // Pebay, "Formulas for robust, one-pass parallel computation of
+  // covariances and arbitrary-order statistical moments" (2008)
+  double const na    = static_cast<double>(n);
+  double const nb    = static_cast<double>(other.n);
+  double const N     = na + nb;
+  double const delta = other.mean - mean;
+  double const d2    = delta * delta;
+
+  double const new_m4 =
+      m4 + other.m4
+      + d2 * d2 * na * nb * (na * na - na * nb + nb * nb) / (N * N * N)
+      + 6 * d2 * (na * na * other.m2 + nb * nb * m2) / (N * N)
+      + 4 * delta * (na * other.m3 - nb * m3) / N;
+  double const new_m3 = m3 + other.m3
+                      + d2 * delta * na * nb * (na - nb) / (N * N)
+                      + 3 * delta * (na * other.m2 - nb * m2) / N;
+  m2 += other.m2 + d2 * na * nb / N;
+  m3 = new_m3;
+  m4 = new_m4;
+  mean += delta * nb / N;
+  n += other.n;
+}
+
+std::int64_t Sample::size() const
 {
   return n;
 }
@@ -30,26 +144,43 @@ Statistics Sample::statistics() const
     throw std::runtime_error{"Not enough entries to run a statistics"};
   }
 
-  // https://mathworld.wolfram.com/SampleCentralmoment.html
-  double m1 = s1 / n;
-  double m2 = s2 / n - m1 * m1;
-  double m3 = s3 / n - 3 * m1 * s2 / n + 2 * std::pow(m1, 3);
-  double m4 =
-      s4 / n - 4 * m1 * s3 / n + 6 * m1 * m1 * s2 / n - 3 * std::pow(m1, 4);
-  
   double N = static_cast<double>(n);
 
-  double mean    = m1;
+  // https://mathworld.wolfram.com/SampleCentralmoment.html
+  double c2 = m2 / N;
+  double c3 = m3 / N;
+  double c4 = m4 / N;
 
-  double std_dev = std::sqrt(m2 * n / (n - 1));
+  double std_dev = std::sqrt(m2 / (N - 1));
 
   // http://brownmath.com/stat/shape.htm#SkewnessCompute
   double skew = std::sqrt(N * (N-1) )
-              / (N - 2) * m3 / std::pow(m2, 1.5);
+              / (N - 2) * c3 / std::pow(c2, 1.5);
 
   double kurt = (N - 1)
               / ((N - 2) * (N - 3))
-              * ((N + 1) * (m4 / (m2 * m2) - 3.) + 6.);
+              * ((N + 1) * (c4 / (c2 * c2) - 3.) + 6.);
 
   return {mean, std_dev, skew, kurt};
+}
+
+double Sample::mean_error() const
+{
+  if (n < 2) {
+    return std::numeric_limits<double>::infinity();
+  }
+  double N = static_cast<double>(n);
+  return std::sqrt(m2 / (N * (N - 1)));
+}
+
+double Sample::std_dev_error() const
+{
+  if (n < 2) {
+    return std::numeric_limits<double>::infinity();
+  }
+  double N = static_cast<double>(n);
+  double c2 = m2 / N;
+  double c4 = m4 / N;
+  // var(s^2) = (c4 - c2^2) / N, var(s) = var(s^2) / (4 s^2)
+  return std::sqrt(std::max(c4 - c2 * c2, 0.) / (4. * N * c2));
 }
\ No newline at end of file
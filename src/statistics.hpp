@@ -1,6 +1,9 @@
 #ifndef STATISTICS_HPP
 #define STATISTICS_HPP
 
+#include <cstdint>
+#include <span>
+
 struct Statistics
 {
   double mean{};
@@ -9,20 +12,39 @@ struct Statistics
   double kurtosis{}; // implemented as excess kurtosis
 };
 
+// first four central moments, updated online (Welford, Terriberry) and
+// merged with Pebay's formulas: no raw power sums, so no cancellation
 class Sample
 {
-  int n;
-  double s1;
-  double s2;
-  double s3;
-  double s4;
+  std::int64_t n;
+  double mean;
+  // sums of (x - mean)^k
+  double m2;
+  double m3;
+  double m4;
+
+  Sample(std::int64_t count, double avg, double sum2, double sum3,
+         double sum4);
+  void add_block(std::span<double const> xs);
 
  public:
   Sample();
   
   void add(double x);
-  int size();
+  // same result as adding the entries one by one, up to rounding, but
+  // vectorised: the moments of blocks of entries are computed in two passes
+  // and merged
+  void add(std::span<double const> xs);
+  // adds all the entries of another sample to this one
+  void merge(Sample const& other);
+  std::int64_t size() const;
 
   Statistics statistics() const;
+
+  // standard errors of statistics().mean and statistics().std_dev, the
+  // latter from the delta method, for large samples; infinite with less than
+  // two entries
+  double mean_error() const;
+  double std_dev_error() const;
 };
 #endif
\ No newline at end of file
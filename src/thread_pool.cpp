@@ -0,0 +1,90 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <utility>
+
+ThreadPool::ThreadPool(unsigned n_threads)
+{
+  if (n_threads == 0) {
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  workers_.reserve(n_threads);
+  for (unsigned i{0}; i != n_threads; ++i) {
+    workers_.emplace_back([this] { work(); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock{m_};
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  // joins the workers while the members they use are still alive
+  workers_.clear();
+}
+
+unsigned ThreadPool::size() const
+{
+  return static_cast<unsigned>(workers_.size());
+}
+
+void ThreadPool::work()
+{
+  std::uint64_t seen{0};
+  for (;;) {
+    std::function<void(std::size_t)> const* task;
+    std::size_t n_tasks;
+    {
+      std::unique_lock lock{m_};
+      work_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen    = generation_;
+      task    = task_;
+      n_tasks = n_tasks_;
+    }
+
+    for (std::size_t i{next_++}; i < n_tasks; i = next_++) {
+      try {
+        (*task)(i);
+      } catch (...) {
+        std::lock_guard lock{m_};
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+        next_ = n_tasks; // skip the remaining tasks
+      }
+    }
+
+    std::lock_guard lock{m_};
+    if (--busy_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::parallel_for(std::size_t n_tasks,
+                              std::function<void(std::size_t)> const& task)
+{
+  if (n_tasks == 0) {
+    return;
+  }
+
+  std::unique_lock lock{m_};
+  task_    = &task;
+  n_tasks_ = n_tasks;
+  next_    = 0;
+  busy_    = workers_.size();
+  error_   = nullptr;
+  ++generation_;
+  work_cv_.notify_all();
+
+  done_cv_.wait(lock, [&] { return busy_ == 0; });
+  task_ = nullptr;
+
+  if (error_) {
+    std::rethrow_exception(std::exchange(error_, nullptr));
+  }
+}
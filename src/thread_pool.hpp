@@ -0,0 +1,49 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads, kept alive between calls to parallel_for
+class ThreadPool
+{
+  std::vector<std::jthread> workers_;
+
+  std::mutex m_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+
+  std::function<void(std::size_t)> const* task_{nullptr};
+  std::size_t n_tasks_{0};
+  std::atomic<std::size_t> next_{0};
+  std::size_t busy_{0};
+  std::uint64_t generation_{0};
+  bool stop_{false};
+  std::exception_ptr error_;
+
+  void work();
+
+ public:
+  // n_threads = 0 uses every available core
+  explicit ThreadPool(unsigned n_threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const&)            = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  unsigned size() const;
+
+  // calls task(i) for every i in [0, n_tasks), returns when all calls are
+  // done; the first exception thrown by a task is rethrown here
+  void parallel_for(std::size_t n_tasks,
+                    std::function<void(std::size_t)> const& task);
+};
+
+#endif
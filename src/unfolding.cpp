@@ -0,0 +1,274 @@
+#include "unfolding.hpp"
+#include "counters.hpp"
+#include "globals.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+
+// walls whose slopes differ less than this are treated as parallel
+constexpr double PARALLEL_EPS{1e-9};
+// bounce counts are clamped here, well above Globals::MAX_ITERATIONS
+constexpr double MANY_BOUNCES{1e6};
+
+// y = q + m * x
+struct Line
+{
+  double q;
+  double m;
+};
+
+Line as_line(Barrier const& b)
+{
+  auto const coeff = b.pol().coeff();
+  return {coeff[0], coeff.size() > 1 ? coeff[1] : 0.};
+}
+
+long parity(long m)
+{
+  return ((m % 2) + 2) % 2;
+}
+
+Vec2 unit(Vec2 v)
+{
+  return v.normalize();
+}
+
+// components of w in the orthonormal basis e1, e2
+Vec2 local(Vec2 const& w, Vec2 const& e1, Vec2 const& e2)
+{
+  return {dot(w, e1), dot(w, e2)};
+}
+
+// number of consecutive bounces on the walls met at angular distances
+// u, u + step, u + 2 step, ... from the point of the line nearest to the apex;
+// a bounce is inside the wall segment if lo <= |u| <= hi
+double n_valid_wedge(double u, double step, double lo, double hi)
+{
+  if (hi < 0. || u < -hi) {
+    return 0.;
+  }
+  double n{0.};
+  if (u <= -lo) {
+    double k{std::floor((-lo - u) / step) + 1.};
+    n += k;
+    u += k * step;
+  }
+  if (u < lo) {
+    return n;
+  }
+  if (u <= hi) {
+    n += std::floor((hi - u) / step) + 1.;
+  }
+  return std::min(n, MANY_BOUNCES);
+}
+
+// number of consecutive bounces on the walls met at coordinates
+// a, a + step, a + 2 step, ... along parallel walls
+double n_valid_parallel(double a, double step, double min, double max)
+{
+  if (a < min || a > max) {
+    return 0.;
+  }
+  if (step > 0.) {
+    return std::min(std::floor((max - a) / step) + 1., MANY_BOUNCES);
+  }
+  if (step < 0.) {
+    return std::min(std::floor((min - a) / step) + 1., MANY_BOUNCES);
+  }
+  return MANY_BOUNCES;
+}
+
+} // namespace
+
+Unfolding::Unfolding(Barrier const& barrier_up, Barrier const& barrier_down)
+    : barrier_up_{barrier_up}
+    , barrier_down_{barrier_down}
+{
+  Line const up{as_line(barrier_up)};
+  Line const down{as_line(barrier_down)};
+  double const l{barrier_up.max()};
+
+  Vec2 const up_first{0., up.q};
+  Vec2 const up_last{l, up.q + up.m * l};
+  Vec2 const down_first{0., down.q};
+  Vec2 const down_last{l, down.q + down.m * l};
+
+  parallel_ = std::abs(up.m - down.m) < PARALLEL_EPS;
+
+  if (parallel_) {
+    origin_ = down_first;
+    e1_     = unit({1., down.m});
+    e2_     = e1_.ortho();
+    width_  = dot(up_first - origin_, e2_);
+
+    auto along = [&](Vec2 const& a, Vec2 const& b) {
+      double const a1{dot(a - origin_, e1_)};
+      double const a2{dot(b - origin_, e1_)};
+      return Segment{std::min(a1, a2), std::max(a1, a2)};
+    };
+    down_ = along(down_first, down_last);
+    up_   = along(up_first, up_last);
+  } else {
+    double const x_apex{(down.q - up.q) / (up.m - down.m)};
+    origin_ = {x_apex, up.q + up.m * x_apex};
+
+    Vec2 const e_down{unit((down_first + down_last) * 0.5 - origin_)};
+    Vec2 const e_up{unit((up_first + up_last) * 0.5 - origin_)};
+    width_ = std::acos(std::clamp(dot(e_down, e_up), -1., 1.));
+    e1_    = e_down;
+    e2_    = unit(e_up - e_down * std::cos(width_));
+
+    auto distance = [&](Vec2 const& a, Vec2 const& b) {
+      double const d1{(a - origin_).norm()};
+      double const d2{(b - origin_).norm()};
+      return Segment{std::min(d1, d2), std::max(d1, d2)};
+    };
+    down_ = distance(down_first, down_last);
+    up_   = distance(up_first, up_last);
+  }
+}
+
+std::optional<Unfolding> Unfolding::make(Barrier const& barrier_up,
+                                         Barrier const& barrier_down)
+{
+  if (barrier_up.pol().deg() > 1 || barrier_down.pol().deg() > 1
+      || barrier_up.max() != barrier_down.max()) {
+    return std::nullopt;
+  }
+  double const l{barrier_up.max()};
+  if (barrier_up.pol()(0.) <= barrier_down.pol()(0.)
+      || barrier_up.pol()(l) <= barrier_down.pol()(l)) {
+    return std::nullopt;
+  }
+  return Unfolding{barrier_up, barrier_down};
+}
+
+// the unfolded copies of the channel are sectors [j * width, (j+1) * width]
+// around the apex: boundary m is the lower wall for even m, the upper one for
+// odd m, and copy j is mapped back by phi -> phi - j * width (even j) or
+// phi -> (j+1) * width - phi (odd j)
+Trajectory Unfolding::unfold_wedge(Trajectory const& t, int& n_bounces) const
+{
+  Vec2 const z0{local(t.p_ - origin_, e1_, e2_)};
+  Vec2 const w0{local(t.v_, e1_, e2_)};
+
+  double const ang_mom{z0.x_ * w0.y_ - z0.y_ * w0.x_};
+  double const p{std::abs(ang_mom)};
+  if (p < Globals::EPS) { // radial trajectory, never meets a wall
+    n_bounces = 0;
+    return t;
+  }
+
+  // the angle moves from phi0 towards phi_n + sigma * pi / 2, boundary m is
+  // crossed at distance p / cos(u) from the apex
+  double const sigma{ang_mom > 0. ? 1. : -1.};
+  Vec2 const foot{z0 - w0 * dot(z0, w0)};
+  double const phi0{std::atan2(z0.y_, z0.x_)};
+  double const phi_n{phi0
+                     + std::atan2(z0.x_ * foot.y_ - z0.y_ * foot.x_,
+                                  dot(z0, foot))};
+  long const m1{sigma > 0. ? 1 : 0};
+  double const u0{sigma * (static_cast<double>(m1) * width_ - phi_n)};
+
+  auto const n_valid = [&](long c) {
+    long const m{m1 + static_cast<long>(sigma) * c};
+    Segment const& s{parity(m) == 0 ? down_ : up_};
+    double const lo{p < s.min ? std::acos(p / s.min) : 0.};
+    double const hi{p <= s.max ? std::acos(p / s.max) : -1.};
+    return n_valid_wedge(u0 + static_cast<double>(c) * width_, 2. * width_, lo,
+                         hi);
+  };
+  double const n{std::min(2. * n_valid(0), 2. * n_valid(1) + 1.)};
+  n_bounces = static_cast<int>(n);
+  if (n_bounces == 0 || n_bounces >= Globals::MAX_ITERATIONS) {
+    return t;
+  }
+
+  // state right after the last bounce
+  long const k{n_bounces - 1};
+  long const m{m1 + static_cast<long>(sigma) * k};
+  double const u{u0 + static_cast<double>(k) * width_};
+  Vec2 const e_wall{parity(m) == 0
+                        ? e1_
+                        : e1_ * std::cos(width_) + e2_ * std::sin(width_)};
+
+  long const j{sigma > 0. ? m : m - 1};
+  double const psi{std::atan2(w0.y_, w0.x_)};
+  double const psi_folded{parity(j) == 0
+                              ? psi - static_cast<double>(j) * width_
+                              : static_cast<double>(j + 1) * width_ - psi};
+
+  Trajectory res{t};
+  res.p_ = origin_ + e_wall * (p / std::cos(u));
+  res.v_ = e1_ * std::cos(psi_folded) + e2_ * std::sin(psi_folded);
+  return res;
+}
+
+// the unfolded copies of the channel are strips [j * width, (j+1) * width]
+// across the walls, odd copies are mirrored
+Trajectory Unfolding::unfold_parallel(Trajectory const& t,
+                                      int& n_bounces) const
+{
+  Vec2 const z0{local(t.p_ - origin_, e1_, e2_)};
+  Vec2 const w0{local(t.v_, e1_, e2_)};
+
+  if (std::abs(w0.y_) < Globals::EPS) { // moving along the walls
+    n_bounces = 0;
+    return t;
+  }
+
+  // boundary m1 + sigma * i is crossed at time t_first + i * dt
+  double const sigma{w0.y_ > 0. ? 1. : -1.};
+  long const m1{sigma > 0. ? 1 : 0};
+  double const t_first{(static_cast<double>(m1) * width_ - z0.y_) / w0.y_};
+  double const dt{width_ / std::abs(w0.y_)};
+
+  auto const n_valid = [&](long c) {
+    long const m{m1 + static_cast<long>(sigma) * c};
+    Segment const& s{parity(m) == 0 ? down_ : up_};
+    double const a{z0.x_ + w0.x_ * (t_first + static_cast<double>(c) * dt)};
+    return n_valid_parallel(a, 2. * w0.x_ * dt, s.min, s.max);
+  };
+  double const n{std::min(2. * n_valid(0), 2. * n_valid(1) + 1.)};
+  n_bounces = static_cast<int>(n);
+  if (n_bounces == 0 || n_bounces >= Globals::MAX_ITERATIONS) {
+    return t;
+  }
+
+  // state right after the last bounce
+  long const k{n_bounces - 1};
+  long const m{m1 + static_cast<long>(sigma) * k};
+  double const a{z0.x_ + w0.x_ * (t_first + static_cast<double>(k) * dt)};
+  double const h{parity(m) == 0 ? 0. : width_};
+  long const j{sigma > 0. ? m : m - 1};
+
+  Trajectory res{t};
+  res.p_ = origin_ + e1_ * a + e2_ * h;
+  res.v_ = e1_ * w0.x_ + e2_ * (parity(j) == 0 ? w0.y_ : -w0.y_);
+  return res;
+}
+
+Result Unfolding::simulate(Trajectory t) const
+{
+  assert(std::abs(t.p_.y_) < barrier_up_.pol()(0.));
+
+  if (std::abs(t.v_.x_) < Globals::EPS) {
+    return simulate_single_particle(barrier_up_, barrier_down_, t);
+  }
+
+  int n_bounces{0};
+  t = parallel_ ? unfold_parallel(t, n_bounces) : unfold_wedge(t, n_bounces);
+  if (n_bounces >= Globals::MAX_ITERATIONS) {
+    return simulate_single_particle(barrier_up_, barrier_down_, t);
+  }
+
+  Counters::add(Counters::Event::unfolded);
+  if (t.v_.x_ > 0) {
+    t.exit(barrier_up_.max());
+  } else {
+    t.exit(0.);
+  }
+  return t.result();
+}
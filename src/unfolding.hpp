@@ -0,0 +1,51 @@
+#ifndef UNFOLDING_HPP
+#define UNFOLDING_HPP
+
+#include "kinematics.hpp"
+#include <optional>
+
+// exact simulation for a pair of linear barriers, in O(1) per particle:
+// reflecting the channel across its walls turns the trajectory into a
+// straight line, so the number of bounces and the final state can be computed
+// directly. simulate_single_particle remains the reference implementation and
+// is used when the bounces are too many (Globals::MAX_ITERATIONS) or the
+// trajectory is vertical.
+class Unfolding
+{
+  // range of a wall segment: distance from the apex for a wedge, coordinate
+  // along the walls for parallel walls
+  struct Segment
+  {
+    double min;
+    double max;
+  };
+
+  Barrier barrier_up_;
+  Barrier barrier_down_;
+  bool parallel_;
+
+  // wedge: apex, unit vector along the lower wall, unit vector orthogonal to
+  // it towards the upper wall, opening angle
+  // parallel walls: origin on the lower wall, unit vector along the walls,
+  // unit normal towards the upper wall, width
+  Vec2 origin_;
+  Vec2 e1_;
+  Vec2 e2_;
+  double width_;
+  Segment down_;
+  Segment up_;
+
+  Unfolding(Barrier const& barrier_up, Barrier const& barrier_down);
+
+  Trajectory unfold_wedge(Trajectory const& t, int& n_bounces) const;
+  Trajectory unfold_parallel(Trajectory const& t, int& n_bounces) const;
+
+ public:
+  // empty if the barriers are not both linear, or do not form a channel
+  static std::optional<Unfolding> make(Barrier const& barrier_up,
+                                       Barrier const& barrier_down);
+
+  Result simulate(Trajectory t) const;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "counters.hpp"
+#include "kinematics.hpp"
+#include "thread_pool.hpp"
+#include "doctest.h"
+#include <algorithm>
+#include <numbers>
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("testing the hot-path counters")
+{
+  using Counters::Event;
+  auto count = [](Counters::Counts const& c, Event e) {
+    return c[static_cast<std::size_t>(e)];
+  };
+
+  double l{4};
+  Pol quadratic{1.5, 0.1, -0.05};
+  Barrier up{quadratic, l};
+  Barrier down{-quadratic, l};
+  Pol flat{std::vector<double>{1.5, 0.}};
+
+  Counters::reset();
+  std::vector<Vec2> bounces;
+  simulate_single_particle(up, down, {{0., 0.}, 0.9}, &bounces);
+  std::size_t const n_bounces{bounces.size() - 2};
+  REQUIRE(n_bounces > 0);
+
+  // counts of the threads of the pool are added up
+  ThreadPool pool{3};
+  pool.parallel_for(30, [&](std::size_t) {
+    simulate_single_particle(up, down, {{0., 0.}, 0.9});
+  });
+  // vertical trajectory, and too many bounces between parallel barriers
+  simulate_single_particle(up, down, {{0., 0.3}, std::numbers::pi / 2.});
+  simulate_single_particle(Barrier{flat, l}, Barrier{-flat, l},
+                           {{0., 0.}, 1.55829698});
+
+  Counters::Counts const c{Counters::total()};
+  if constexpr (Counters::ENABLED) {
+    CHECK(count(c, Event::particles) == 33);
+    CHECK(count(c, Event::bounces) >= 31 * n_bounces);
+    CHECK(count(c, Event::max_iterations) == 1);
+    CHECK(count(c, Event::vertical) > 0);
+    CHECK(count(c, Event::intersections) >= 2 * count(c, Event::bounces));
+    CHECK(count(c, Event::eq_solves) > 0);
+    CHECK(count(c, Event::roots_found) >= count(c, Event::roots_rejected));
+    CHECK(count(c, Event::roots_found) - count(c, Event::roots_rejected)
+          >= count(c, Event::bounces) - count(c, Event::vertical));
+
+    std::ostringstream os;
+    Counters::report(os, 0.5);
+    CHECK(os.str().find("particles=33 ") == 0);
+    CHECK(os.str().find(" particles_per_second=66 ") != std::string::npos);
+  } else {
+    CHECK(std::all_of(c.begin(), c.end(), [](auto n) { return n == 0; }));
+  }
+
+  Counters::reset();
+  Counters::Counts const zero{Counters::total()};
+  CHECK(std::all_of(zero.begin(), zero.end(), [](auto n) { return n == 0; }));
+}
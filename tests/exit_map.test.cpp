@@ -0,0 +1,144 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "exit_map.hpp"
+#include "montecarlo.hpp"
+#include "doctest.h"
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+std::string temp_path(std::string const& name)
+{
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+} // namespace
+
+TEST_CASE("testing the exit map")
+{
+  Barrier barrier_up{4., 1.5, 0.7};
+  Barrier barrier_down{4., -1.5, -0.7};
+  Beam beam{0., 0.5, 0., 0.4};
+  ThreadPool pool{2};
+
+  ExitMapOptions const options{1e-4, 4, 9};
+  ExitMap const map{ExitMap::build(barrier_up, barrier_down, options, pool)};
+  CHECK(map.n_leaves() >= 16 * 16);
+  CHECK(map.matches(barrier_up, barrier_down));
+  CHECK_FALSE(map.matches(Barrier{4., 1.5, 0.8}, barrier_down));
+  CHECK_FALSE(map.matches(Barrier{5., 1.5, 0.7}, Barrier{5., -1.5, -0.7}));
+
+  SUBCASE("lookup agrees with the exact engine")
+  {
+    for (double y0 : {-1.2, -0.3, 0., 0.45, 1.1}) {
+      for (double theta0 : {-1.3, -0.4, 0.05, 0.6, 1.4}) {
+        auto const e = map.lookup(y0, theta0);
+        if (!e) {
+          continue;
+        }
+        Result const exact{simulate_single_particle(
+            barrier_up, barrier_down, Trajectory{{0., y0}, theta0})};
+        CHECK(e->right == (exact.get_x() == barrier_up.max()));
+        if (e->right) {
+          CHECK(e->y == doctest::Approx(exact.get_y()).epsilon(1e-3));
+          CHECK(e->theta == doctest::Approx(exact.get_theta()).epsilon(1e-3));
+        }
+      }
+    }
+    CHECK_FALSE(map.lookup(1.6, 0.));
+    CHECK_FALSE(map.lookup(0., 2.));
+  }
+
+  SUBCASE("accuracy against the exact engine")
+  {
+    std::size_t const n{CHUNK_SIZE + 77};
+    ExitMapAccuracy const acc{
+        exit_map_accuracy(map, barrier_up, barrier_down, beam, n, 42, pool)};
+    CHECK(acc.n == n);
+    // only the particles close to a discontinuity are simulated
+    CHECK(acc.served > n * 4 / 5);
+    CHECK(acc.misclassified == 0);
+    CHECK(acc.n_compared > 0);
+    CHECK(acc.y_rms_error <= acc.y_max_error);
+    // the tolerance is checked at a few points of each leaf
+    CHECK(acc.y_max_error < 2e-4);
+    CHECK(acc.theta_max_error < 2e-4);
+
+    auto const exact =
+        simulate_n_particles(barrier_up, barrier_down, beam, n, 42, pool);
+    auto const mapped = simulate_n_particles(map, barrier_up, barrier_down,
+                                             beam, n, 42, pool);
+    CHECK(mapped.n_generated == n);
+    CHECK(mapped.y.size() == exact.y.size());
+    CHECK(std::abs(mapped.y.statistics().mean - exact.y.statistics().mean)
+          < 1e-4);
+    CHECK(std::abs(mapped.theta.statistics().std_dev
+                   - exact.theta.statistics().std_dev)
+          < 1e-4);
+
+    CHECK_THROWS_AS(simulate_n_particles(map, Barrier{4., 1.5, 0.8},
+                                         barrier_down, beam, n, 42, pool),
+                    std::invalid_argument);
+  }
+
+  SUBCASE("a saved map is memory mapped back")
+  {
+    std::string const path{temp_path("biliardo_exit_map.bin")};
+    map.save(path);
+    {
+      ExitMap const mapped{ExitMap::map(path)};
+      CHECK(mapped.n_leaves() == map.n_leaves());
+      CHECK(mapped.matches(barrier_up, barrier_down));
+      for (double y0 : {-0.7, 0.2, 1.3}) {
+        auto const a = map.lookup(y0, 0.3);
+        auto const b = mapped.lookup(y0, 0.3);
+        REQUIRE(a.has_value() == b.has_value());
+        if (a) {
+          CHECK(a->right == b->right);
+          CHECK(a->y == b->y);
+          CHECK(a->theta == b->theta);
+        }
+      }
+    }
+
+    // a range that lookup would divide by
+    for (double y_hi : {-1.5, std::nan(""), HUGE_VAL}) {
+      map.save(path);
+      std::fstream file{path, std::ios::binary | std::ios::in | std::ios::out};
+      file.seekp(offsetof(ExitMap::Header, y_hi));
+      file.write(reinterpret_cast<char const*>(&y_hi), sizeof(y_hi));
+      file.close();
+      CHECK_THROWS_AS(ExitMap::map(path), std::runtime_error);
+    }
+
+    map.save(path);
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    CHECK_THROWS_AS(ExitMap::map(path), std::runtime_error);
+    {
+      std::ofstream file{path, std::ios::binary};
+      file << "not an exit map, just some text";
+    }
+    CHECK_THROWS_AS(ExitMap::map(path), std::runtime_error);
+    std::filesystem::remove(path);
+    CHECK_THROWS_AS(ExitMap::map(path), std::runtime_error);
+  }
+
+  SUBCASE("invalid depths")
+  {
+    CHECK_THROWS_AS(
+        ExitMap::build(barrier_up, barrier_down, {1e-4, 6, 5}, pool),
+        std::invalid_argument);
+    CHECK_THROWS_AS(
+        ExitMap::build(barrier_up, barrier_down, {1e-4, 5, 30}, pool),
+        std::invalid_argument);
+    // 2^48 root cells: rejected before they are allocated
+    CHECK_THROWS_AS(
+        ExitMap::build(barrier_up, barrier_down, {1e-4, 24, 24}, pool),
+        std::invalid_argument);
+    CHECK_THROWS_AS(
+        ExitMap::build(barrier_up, barrier_down, {1e-4, 16, 16}, pool),
+        std::invalid_argument);
+  }
+}
@@ -0,0 +1,90 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "job.hpp"
+#include "doctest.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("testing the job parameters")
+{
+  Job const job{{"l=4", "n=1000000", "seed=18446744073709551615",
+                 "pol=1.5,0,-0.1", "format=bin32"}};
+
+  CHECK(job.has("l"));
+  CHECK_FALSE(job.has("r1"));
+  CHECK(job.get<double>("l") == 4.);
+  CHECK(job.get<std::size_t>("n") == 1'000'000);
+  CHECK(job.get<std::uint64_t>("seed") == 18446744073709551615u);
+  CHECK(job.get<std::string>("format") == "bin32");
+  CHECK(job.get_list("pol") == std::vector<double>{1.5, 0., -0.1});
+  CHECK(job.get("sigma_y", 1.) == 1.);
+  CHECK_NOTHROW(job.check_unused());
+
+  SUBCASE("invalid values")
+  {
+    CHECK_THROWS_AS(job.get<double>("r1"), std::invalid_argument);
+    CHECK_THROWS_AS(Job{{"n=2.5"}}.get<int>("n"), std::invalid_argument);
+    CHECK_THROWS_AS(job.get<double>("format"), std::invalid_argument);
+    CHECK_THROWS_AS((Job{{"l=4", "l=5"}}), std::invalid_argument);
+    CHECK_THROWS_AS(Job{{"l"}}, std::invalid_argument);
+    CHECK_THROWS_AS(Job{{"=4"}}, std::invalid_argument);
+    CHECK_THROWS_AS(Job{{"pol=1,,2"}}.get_list("pol"), std::invalid_argument);
+    CHECK_THROWS_AS(Job{{"pol=1,2,"}}.get_list("pol"), std::invalid_argument);
+  }
+
+  SUBCASE("unknown parameters are reported")
+  {
+    Job const typo{{"l=4", "sigma_t=2"}};
+    typo.get<double>("l");
+    CHECK_THROWS_AS(typo.check_unused(), std::invalid_argument);
+  }
+}
+
+TEST_CASE("testing the grids of a sweep")
+{
+  Job const job{{"l=4", "r1=1,1.5", "r2=0:1:5", "a=2:3:1", "b=1:2", "c=1:2:x"}};
+  CHECK(job.get_grid("l") == std::vector<double>{4.});
+  CHECK(job.get_grid("r1") == std::vector<double>{1., 1.5});
+  CHECK(job.get_grid("r2") == std::vector<double>{0., 0.25, 0.5, 0.75, 1.});
+  CHECK(job.get_grid("a") == std::vector<double>{2.});
+  CHECK_THROWS_AS(job.get_grid("b"), std::invalid_argument);
+  CHECK_THROWS_AS(job.get_grid("c"), std::invalid_argument);
+  CHECK_THROWS_AS(Job{{"l=1:2:0"}}.get_grid("l"), std::invalid_argument);
+}
+
+TEST_CASE("testing the job files")
+{
+  std::istringstream in{"# comment\n"
+                        "l=4 r1=1.5 r2=0.7 n=10\n"
+                        "\n"
+                        "   l=5  r1=1 r2=1\tn=20  \n"};
+  auto const jobs = read_jobs(in);
+  REQUIRE(jobs.size() == 2);
+  CHECK(jobs[0].get<double>("r2") == 0.7);
+  CHECK(jobs[1].get<double>("l") == 5.);
+  CHECK(jobs[1].get<int>("n") == 20);
+
+  char const* no_args[]{"biliardo"};
+  CHECK(jobs_from_args(1, no_args).empty());
+
+  char const* args[]{"biliardo", "l=4", "n=2"};
+  auto const single = jobs_from_args(3, args);
+  REQUIRE(single.size() == 1);
+  CHECK(single[0].get<int>("n") == 2);
+
+  char const* missing[]{"biliardo", "--jobs", "no_such_file.jobs"};
+  CHECK_THROWS_AS(jobs_from_args(3, missing), std::runtime_error);
+
+  // only comments and blank lines: an error, not an interactive run
+  {
+    std::ofstream file{"empty.test.jobs"};
+    file << "# no jobs\n\n   \n";
+  }
+  char const* empty[]{"biliardo", "--jobs", "empty.test.jobs"};
+  CHECK_THROWS_AS(jobs_from_args(3, empty), std::runtime_error);
+  std::remove("empty.test.jobs");
+}
@@ -1,6 +1,40 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "kinematics.hpp"
+#include "batch.hpp"
 #include "doctest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+
+// every global operator new of this executable is counted, to check that the
+// simulation does not allocate
+namespace {
+std::size_t n_allocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+  ++n_allocations;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+// not inlined: gcc would see free() called on the result of operator new
+// and warn with -Wmismatched-new-delete
+[[gnu::noinline]] void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
 
 TEST_CASE("testing single particle simulation")
 {
@@ -85,4 +119,325 @@ TEST_CASE("testing single particle simulation with parallel barriers")
                                           {{0., 0.}, 1.55829698});
     CHECK(res.get_x() < 4);
   }
-}
\ No newline at end of file
+
+  SUBCASE("vertical particle")
+  {
+    // moving down, the upper barrier is behind the particle
+    std::vector<Vec2> bounces;
+    simulate_single_particle(barrier_up, barrier_down,
+                             {{1., 1.}, -1.5707963267948966}, &bounces);
+    REQUIRE(bounces.size() >= 3);
+    CHECK(bounces[1].x_ == doctest::Approx(1.));
+    CHECK(bounces[1].y_ == doctest::Approx(-1.5));
+    // then up, not again at the point of the bounce
+    CHECK(bounces[2].y_ == doctest::Approx(1.5));
+  }
+}
+TEST_CASE("testing that single particle simulation does not allocate")
+{
+  Barrier linear_up{4., 1.5, 0.7};
+  Barrier linear_down{4., -1.5, -0.7};
+  Pol p{1.5, 0.1, -0.05};
+  Barrier quadratic_up{p, 4.};
+  Barrier quadratic_down{-p, 4.};
+
+  std::size_t const before{n_allocations};
+  for (double theta : {0., 0.291456794, 0.463647609, -0.785398163, 1.55829698,
+                       1.5707963267948966, 3.}) {
+    simulate_single_particle(linear_up, linear_down, {{0., 0.1}, theta});
+    simulate_single_particle(quadratic_up, quadratic_down, {{0., 0.1}, theta});
+  }
+  CHECK(n_allocations == before);
+}
+
+TEST_CASE("testing single particle simulation with higher degree barriers")
+{
+  double l{4};
+
+  SUBCASE("a degree 4 pol with null leading terms behaves as a quadratic")
+  {
+    Pol quadratic{1.5, 0.1, -0.05};
+    Pol quartic{1.5, 0.1, -0.05, 0., 0.};
+    for (double theta : {0.2, 0.5, 1.1, -0.7}) {
+      Result r2 = simulate_single_particle(
+          Barrier{quadratic, l}, Barrier{-quadratic, l}, {{0., 0.1}, theta});
+      Result r4 = simulate_single_particle(
+          Barrier{quartic, l}, Barrier{-quartic, l}, {{0., 0.1}, theta});
+      CHECK(r2.get_x() == doctest::Approx(r4.get_x()));
+      CHECK(r2.get_y() == doctest::Approx(r4.get_y()));
+      CHECK(r2.get_theta() == doctest::Approx(r4.get_theta()));
+    }
+  }
+
+  SUBCASE("particles exit between curved barriers of degree 3 and 6")
+  {
+    Pol cubic{1.5, -0.3, 0.05, 0.01};
+    Pol sextic{1.5, 0., -0.1, 0., 0., 0., 0.0002};
+    for (Pol const& p : {cubic, sextic}) {
+      Barrier up{p, l};
+      Barrier down{-p, l};
+      for (double theta : {0.3, 0.6, 0.9}) {
+        Result res = simulate_single_particle(up, down, {{0., 0.}, theta});
+        CHECK((res.get_x() == doctest::Approx(l) || res.get_x() == 0.));
+        CHECK(std::abs(res.get_y()) <= std::abs(p(res.get_x())) + 1e-9);
+      }
+    }
+  }
+}
+
+TEST_CASE("testing the segments of a barrier and the slab test")
+{
+  double l{4};
+
+  SUBCASE("segments end at the zeros of the first and second derivatives")
+  {
+    // derivative 3x^2 - 6x + 2, second derivative 6x - 6
+    Barrier b{Pol{1., 2., -3., 1.}, l};
+    auto const& segments = b.segments();
+    REQUIRE(segments.size() == 4);
+    CHECK(segments[0].lo.x_ == 0.);
+    CHECK(segments[0].hi.x_ == doctest::Approx(1. - 1. / std::sqrt(3.)));
+    CHECK(segments[1].hi.x_ == doctest::Approx(1.));
+    CHECK(segments[2].hi.x_ == doctest::Approx(1. + 1. / std::sqrt(3.)));
+    CHECK(segments[3].hi.x_ == l);
+    for (std::size_t i{0}; i + 1 != segments.size(); ++i) {
+      CHECK(segments[i].hi.x_ == segments[i + 1].lo.x_);
+    }
+    CHECK(segments[1].der_hi == doctest::Approx(-1.));
+
+    CHECK(Barrier{l, 1.5, 0.7}.segments().size() == 1);
+  }
+
+  SUBCASE("lines crossing the barrier are never skipped")
+  {
+    std::vector<Pol> const pols{Pol{1., 2., -3., 1.},
+                                Pol{1.5, 0., -0.1, 0., 0., 0., 0.0002},
+                                Pol{-1.5, 0.2, 0.1, 0., -0.004}};
+    std::default_random_engine eng{7};
+    std::uniform_real_distribution<double> q_dist{-3., 3.};
+    std::uniform_real_distribution<double> m_dist{-4., 4.};
+    std::uniform_real_distribution<double> x_dist{0., 4.};
+    int n_skipped{0};
+    for (Pol const& p : pols) {
+      Barrier b{p, l};
+      for (int i{0}; i != 2000; ++i) {
+        FixedPol<1> const line{q_dist(eng), m_dist(eng)};
+        double x_min{x_dist(eng)};
+        double x_max{x_dist(eng)};
+        if (x_min > x_max) {
+          std::swap(x_min, x_max);
+        }
+        Roots const roots{eq_solve(line, p, x_min, x_max)};
+        if (!b.may_intersect(line, x_min, x_max)) {
+          ++n_skipped;
+          CHECK(roots.empty());
+        }
+      }
+    }
+    // most random lines miss the barrier
+    CHECK(n_skipped > 1000);
+  }
+
+  SUBCASE("a trajectory leaving a barrier does not cross it again")
+  {
+    Barrier b{Pol{1.5, 0., -0.1, 0., 0., 0., 0.0002}, l};
+    double const x0{1.};
+    // reflected downwards at x0, steeper than the barrier up to x = 3.6
+    FixedPol<1> const line{b.pol()(x0) + x0, -1.};
+    CHECK_FALSE(b.may_intersect(line, x0 + Globals::EPS, l));
+    // going left it stays above the barrier as well
+    CHECK_FALSE(b.may_intersect(line, 0., x0 - Globals::EPS));
+    CHECK(b.may_intersect(FixedPol<1>{1.3, 0.}, 0., l));
+    CHECK_FALSE(b.may_intersect(line, 5., 6.));
+  }
+}
+
+TEST_CASE("testing mirrored barriers")
+{
+  double l{4};
+  Pol quadratic{1.5, 0.1, -0.05};
+  Pol sextic{1.5, 0., -0.1, 0., 0., 0., 0.0002};
+
+  CHECK(Barrier{l, -1.5, -0.7}.mirrors(Barrier{l, 1.5, 0.7}));
+  CHECK(Barrier{-quadratic, l}.mirrors(Barrier{quadratic, l}));
+  CHECK_FALSE(Barrier{-quadratic, l}.mirrors(Barrier{quadratic, l + 1.}));
+  CHECK_FALSE(Barrier{l, -1.5, -0.6}.mirrors(Barrier{l, 1.5, 0.7}));
+  CHECK_FALSE(Barrier{quadratic, l}.mirrors(Barrier{quadratic, l}));
+
+  // the first bounce of simulate_single_particle, which solves both barriers
+  // against the upper one, is the nearest collision found by intersect
+  std::default_random_engine eng{5};
+  std::uniform_real_distribution<double> y_dist{-1.4, 1.4};
+  std::uniform_real_distribution<double> theta_dist{-1.5, 1.5};
+  for (Pol const& p : {Pol{1.5, -0.2}, quadratic, sextic}) {
+    Barrier const up{p, l};
+    Barrier const down{-p, l};
+    for (int i{0}; i != 500; ++i) {
+      Trajectory const t{{0., y_dist(eng)}, theta_dist(eng)};
+      std::vector<Vec2> bounces;
+      simulate_single_particle(up, down, t, &bounces);
+      REQUIRE(bounces.size() >= 2);
+
+      std::vector<Collision> collisions;
+      for (Barrier const* b : {&up, &down}) {
+        auto const c = intersect(t, b);
+        collisions.insert(collisions.end(), c.begin(), c.end());
+      }
+      if (collisions.empty()) {
+        // exit without bounces
+        CHECK(bounces.size() == 2);
+        continue;
+      }
+      auto const nearest = std::min_element(
+          collisions.begin(), collisions.end(),
+          [&](Collision const& a, Collision const& b) {
+            return a.p_.dist2(t.p_) < b.p_.dist2(t.p_);
+          });
+      CHECK(bounces[1].x_ == nearest->p_.x_);
+      CHECK(bounces[1].y_ == nearest->p_.y_);
+    }
+  }
+}
+
+namespace {
+// the particle t of the double engine run by the engine of type T
+template<typename T>
+BasicResult<T> simulate_as(Pol const& p, double l, Trajectory const& t)
+{
+  std::vector<T> coeff;
+  for (double c : p.coeff()) {
+    coeff.push_back(static_cast<T>(c));
+  }
+  BasicPol<T> const pol{coeff};
+  BasicBarrier<T> const up{pol, static_cast<T>(l)};
+  BasicBarrier<T> const down{-pol, static_cast<T>(l)};
+  BasicVec2<T> const p0{static_cast<T>(t.p_.x_), static_cast<T>(t.p_.y_)};
+  double const theta{std::atan2(t.v_.y_, t.v_.x_)};
+  return simulate_single_particle(up, down, {p0, static_cast<T>(theta)});
+}
+} // namespace
+
+TEST_CASE("testing the float and long double engines")
+{
+  double l{4};
+  std::default_random_engine eng{7};
+  std::uniform_real_distribution<double> y_dist{-1.4, 1.4};
+  std::uniform_real_distribution<double> theta_dist{-1.5, 1.5};
+  // the same particles exit on the same side, at about the same height
+  for (Pol const& p : {Pol{1.5, -0.2}, Pol{1.5, 0.1, -0.2, 0.02, 0.001},
+                       Pol{1.5, 0., -0.1, 0., 0., 0., 0.0002},
+                       Pol{1.5, 0.1, -0.05, 1e-6}}) {
+    Barrier const up{p, l};
+    Barrier const down{-p, l};
+    for (int i{0}; i != 500; ++i) {
+      Trajectory const t{{0., y_dist(eng)}, theta_dist(eng)};
+      Result const res{simulate_single_particle(up, down, t)};
+      BasicResult<float> const res_f{simulate_as<float>(p, l, t)};
+      BasicResult<long double> const res_l{
+          simulate_as<long double>(p, l, t)};
+
+      REQUIRE((res_f.get_x() > 0.f) == (res.get_x() > 0.));
+      CHECK(std::abs(res_f.get_y() - res.get_y()) < 2e-3);
+      REQUIRE((res_l.get_x() > 0.L) == (res.get_x() > 0.));
+      CHECK(std::abs(res_l.get_y() - res.get_y()) < 1e-9L);
+    }
+  }
+
+  // after its first bounce the particle goes up with a slope of about 2500,
+  // that amplifies the float error of the x of the next bounce
+  Pol const quartic{1.5, 0.1, -0.2, 0.02, 0.001};
+  Trajectory const steep{{0., 0.903275624}, -0.743624807};
+  Result const res{
+      simulate_single_particle(Barrier{quartic, l}, Barrier{-quartic, l},
+                               steep)};
+  BasicResult<float> const res_f{simulate_as<float>(quartic, l, steep)};
+  REQUIRE(res.get_x() == 0.);
+  CHECK(res_f.get_x() == 0.f);
+  CHECK(std::abs(res_f.get_y() - res.get_y()) < 2e-3);
+}
+
+TEST_CASE("testing batch simulation against single particle simulation")
+{
+  double l{4};
+  Pol quadratic{1.5, 0.1, -0.05};
+  Pol cubic{1.5, -0.3, 0.05, 0.01};
+
+  std::vector<std::pair<Barrier, Barrier>> channels{
+      {Barrier{l, 1.5, 0.7}, Barrier{l, -1.5, -0.7}},
+      {Barrier{l, 1.5, 1.5}, Barrier{l, -1.5, -1.5}},
+      {Barrier{quadratic, l}, Barrier{-quadratic, l}},
+      {Barrier{cubic, l}, Barrier{-cubic, l}}};
+
+  std::vector<double> y0;
+  std::vector<double> theta0;
+  for (int i{0}; i != 600; ++i) {
+    y0.push_back(-1.4 + 2.8 * (i % 37) / 36.);
+    theta0.push_back(-3.1 + 6.2 * (i % 101) / 100.);
+  }
+  // vertical trajectory, handled by the scalar fallback
+  y0.push_back(0.3);
+  theta0.push_back(1.5707963267948966);
+
+  for (auto const& [up, down] : channels) {
+    std::vector<double> x(y0.size());
+    std::vector<double> y(y0.size());
+    std::vector<double> theta(y0.size());
+    simulate_batch(up, down, y0, theta0, x, y, theta);
+
+    int n_mismatch{0};
+    for (std::size_t i{0}; i != y0.size(); ++i) {
+      Result res = simulate_single_particle(up, down, {{0., y0[i]}, theta0[i]});
+      if (x[i] != doctest::Approx(res.get_x())
+          || y[i] != doctest::Approx(res.get_y())
+          || theta[i] != doctest::Approx(res.get_theta())) {
+        ++n_mismatch;
+      }
+    }
+    CHECK(n_mismatch == 0);
+  }
+}
+
+TEST_CASE("testing the bounce step kernels against the scalar one")
+{
+  double l{4};
+  std::vector<std::pair<Coeff, Coeff>> channels{
+      {{1.5, 0.7, 0.}, {-1.5, -0.7, 0.}},
+      {{1.5, -0.2, 0.}, {-1.5, 0.2, 0.}},
+      {{1.5, 0.1, -0.05}, {-1.5, -0.1, 0.05}}};
+
+  std::default_random_engine eng{3};
+  std::uniform_real_distribution<double> y_dist{-1.4, 1.4};
+  std::uniform_real_distribution<double> theta_dist{-3.1, 3.1};
+
+  std::vector<BounceStep> const steps{bounce_steps()};
+  REQUIRE(steps.front() == bounce_step_scalar);
+
+  for (auto const& [up, down] : channels) {
+    Lanes init;
+    for (std::size_t i{0}; i != BLOCK; ++i) {
+      double const theta{theta_dist(eng)};
+      init.px[i]     = 0.;
+      init.py[i]     = y_dist(eng);
+      init.vx[i]     = std::cos(theta);
+      init.vy[i]     = std::sin(theta);
+      init.active[i] = i % 13 == 0 ? 0. : 1.;
+      init.scalar[i] = 0.;
+    }
+
+    // results must be identical bit by bit
+    std::vector<Lanes> reference(2, init);
+    std::vector<Lanes> lanes(2, init);
+    for (BounceStep step : steps) {
+      reference[0] = init;
+      lanes[0]     = init;
+      for (std::size_t it{0}; it != Globals::MAX_ITERATIONS; ++it) {
+        bounce_step_scalar(reference[it % 2], reference[(it + 1) % 2], BLOCK,
+                           up, down, l);
+        step(lanes[it % 2], lanes[(it + 1) % 2], BLOCK, up, down, l);
+        Lanes const& r = reference[(it + 1) % 2];
+        Lanes const& s = lanes[(it + 1) % 2];
+        CHECK(std::memcmp(&r, &s, sizeof(Lanes)) == 0);
+      }
+    }
+  }
+}
@@ -1,6 +1,7 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "mathematics.hpp"
 #include "doctest.h"
+#include <cmath>
 
 TEST_CASE("testing pol")
 {
@@ -45,6 +46,12 @@ TEST_CASE("testing pol")
     CHECK(pol.der(1.) == doctest::Approx(7.5));
     CHECK(pol.der(2.1) == doctest::Approx(14.98));
   }
+
+  SUBCASE("pol with degree higher than supported throws")
+  {
+    std::vector<double> too_many(Globals::MAX_DEGREE + 2, 1.);
+    CHECK_THROWS(Pol{too_many});
+  }
 }
 
 TEST_CASE("testing eq_solve")
@@ -98,7 +105,8 @@ TEST_CASE("testing eq_solve")
   {
     Pol p1({1.0, -3.0, 2.0});
     Pol p2({0.0});
-    std::vector<double> roots = eq_solve(p1, p2);
+    Roots roots = eq_solve(p1, p2);
+    REQUIRE(roots.size() == 2);
     CHECK(roots[0] == doctest::Approx(0.5));
     CHECK(roots[1] == doctest::Approx(1.0));
   }
@@ -162,4 +170,237 @@ TEST_CASE("Testing Vec2")
   {
     CHECK(dot(v1, v2) == doctest::Approx(11.0));
   }
-}
\ No newline at end of file
+
+  SUBCASE("Normalization in place")
+  {
+    Vec2 v3{v1};
+    CHECK(&v3.normalize() == &v3);
+    CHECK(v3 == Vec2{0.6, 0.8});
+    CHECK(v3.norm() == doctest::Approx(1.0));
+  }
+
+  SUBCASE("Reflection")
+  {
+    // across the x axis, the y axis and the diagonal
+    CHECK(v1.reflect({0., 1.}) == Vec2{3.0, -4.0});
+    CHECK(v1.reflect({-1., 0.}) == Vec2{-3.0, 4.0});
+    Vec2 n{1., -1.};
+    CHECK(v1.reflect(n.normalize()) == Vec2{4.0, 3.0});
+    // the same as the decomposition on the tangent and the normal
+    Vec2 tg{1., 0.3};
+    tg.normalize();
+    Vec2 const expected{tg.ortho() * (-dot(v1, tg.ortho()))
+                        + tg * dot(v1, tg)};
+    CHECK(v1.reflect(tg.ortho()) == expected);
+    CHECK(v1.reflect(tg.ortho()).norm() == doctest::Approx(v1.norm()));
+  }
+
+  SUBCASE("Compile-time arithmetic")
+  {
+    constexpr Vec2 a{1., 2.};
+    constexpr Vec2 b{3., -1.};
+    static_assert(dot(a, b) == 1.);
+    static_assert(a.dist2(b) == 13.);
+    static_assert(2. * a - b / 2. == Vec2{0.5, 4.5});
+    static_assert(a.ortho() == Vec2{-2., 1.});
+    static_assert(a.reflect({0., 1.}) == Vec2{1., -2.});
+  }
+}
+TEST_CASE("testing FixedPol")
+{
+  constexpr FixedPol<2> fixed{2.1, 0.7, 3.4};
+  static_assert(fixed(0.) == 2.1);
+  static_assert(fixed.der(0.) == 0.7);
+  static_assert(FixedPol<2>::deg() == 2);
+
+  Pol pol{2.1, 0.7, 3.4};
+
+  SUBCASE("evaluation agrees with Pol")
+  {
+    for (double x : {-1.3, 0., 1., 2.1}) {
+      CHECK(fixed(x) == doctest::Approx(pol(x)));
+      CHECK(fixed.der(x) == doctest::Approx(pol.der(x)));
+    }
+    CHECK(FixedPol<2>{pol}(2.1) == doctest::Approx(18.564));
+  }
+
+  SUBCASE("linear pol has a constant derivative")
+  {
+    FixedPol<1> line{3., -1.};
+    CHECK(line(2.) == doctest::Approx(1.));
+    CHECK(line.der(-5.) == doctest::Approx(-1.));
+  }
+
+  SUBCASE("specialised eq_solve agrees with the generic one")
+  {
+    FixedPol<1> line{1., -2.3};
+    FixedPol<2> quadratic{1.0, -3.0, 2.0};
+    Pol generic_line{1., -2.3};
+    Pol generic_quadratic{1.0, -3.0, 2.0};
+
+    Roots fixed_roots   = eq_solve(line, quadratic);
+    Roots generic_roots = eq_solve(generic_line, generic_quadratic);
+    REQUIRE(fixed_roots.size() == generic_roots.size());
+    for (std::size_t i{0}; i != fixed_roots.size(); ++i) {
+      CHECK(fixed_roots[i] == doctest::Approx(generic_roots[i]));
+    }
+
+    FixedPol<1> bar{3., -1.};
+    CHECK(eq_solve(line, bar)[0] == doctest::Approx(-1.53846154));
+    CHECK(eq_solve(FixedPol<1>{2.99, -1.}, bar).size() == 0);
+  }
+}
+
+TEST_CASE("testing higher degree solvers")
+{
+  SUBCASE("cubic with three real roots")
+  {
+    // (x - 1)(x - 2)(x - 3)
+    Roots roots = solve_cubic(1., -6., 11., -6.);
+    REQUIRE(roots.size() == 3);
+    CHECK(roots[0] == doctest::Approx(1.));
+    CHECK(roots[1] == doctest::Approx(2.));
+    CHECK(roots[2] == doctest::Approx(3.));
+  }
+
+  SUBCASE("cubic with one real root")
+  {
+    // (x - 2)(x^2 + 1)
+    Roots roots = solve_cubic(2., -4., 2., -4.);
+    REQUIRE(roots.size() == 1);
+    CHECK(roots[0] == doctest::Approx(2.));
+  }
+
+  SUBCASE("cubic with negligible leading coefficient is a quadratic")
+  {
+    Roots roots = solve_cubic(0., 2.0, -3.0, 1.0);
+    REQUIRE(roots.size() == 2);
+    CHECK(roots[0] == doctest::Approx(0.5));
+    CHECK(roots[1] == doctest::Approx(1.0));
+  }
+
+  SUBCASE("quartic with four real roots")
+  {
+    // (x + 2)(x + 1)(x - 1)(x - 3)
+    Roots roots = solve_quartic(1., -1., -7., 1., 6.);
+    REQUIRE(roots.size() == 4);
+    CHECK(roots[0] == doctest::Approx(-2.));
+    CHECK(roots[1] == doctest::Approx(-1.));
+    CHECK(roots[2] == doctest::Approx(1.));
+    CHECK(roots[3] == doctest::Approx(3.));
+  }
+
+  SUBCASE("biquadratic and rootless quartics")
+  {
+    // (x^2 - 1)(x^2 - 4)
+    Roots roots = solve_quartic(3., 0., -15., 0., 12.);
+    REQUIRE(roots.size() == 4);
+    CHECK(roots[0] == doctest::Approx(-2.));
+    CHECK(roots[3] == doctest::Approx(2.));
+
+    CHECK(solve_quartic(1., 0., 1., 0., 1.).size() == 0);
+  }
+
+  SUBCASE("quintic restricted to an interval")
+  {
+    // x (x - 0.5)(x - 1.5)(x + 1)(x - 4)
+    std::vector<double> coeff{0., -3., 5.75, 2.75, -5., 1.};
+    Roots all = solve_sturm(coeff, -10., 10.);
+    REQUIRE(all.size() == 5);
+    CHECK(all[0] == doctest::Approx(-1.));
+    CHECK(all[1] == doctest::Approx(0.).epsilon(1e-12));
+    CHECK(all[2] == doctest::Approx(0.5));
+    CHECK(all[3] == doctest::Approx(1.5));
+    CHECK(all[4] == doctest::Approx(4.));
+
+    Roots some = solve_sturm(coeff, 0.1, 2.);
+    REQUIRE(some.size() == 2);
+    CHECK(some[0] == doctest::Approx(0.5));
+    CHECK(some[1] == doctest::Approx(1.5));
+
+    // a root at the lower end of the interval is not in it
+    Roots above_zero = solve_sturm(coeff, 0., 1.);
+    REQUIRE(above_zero.size() == 1);
+    CHECK(above_zero[0] == doctest::Approx(0.5));
+    std::vector<double> const quintic{0., -0.2, 0., 0., 0., 0.0012};
+    Roots const one = solve_sturm(quintic, 0., 4.);
+    REQUIRE(one.size() == 1);
+    CHECK(one[0] == doctest::Approx(std::pow(0.2 / 0.0012, 0.25)));
+  }
+
+  SUBCASE("eq_solve of degree 6 against a line, in an interval")
+  {
+    // x^6 - x = 0.5 - 0.5 has roots 0 and 1 only
+    Pol pol{0.5, -1., 0., 0., 0., 0., 1.};
+    Pol line{0.5};
+    Roots roots = eq_solve(pol, line, 0.5, 3.);
+    REQUIRE(roots.size() == 1);
+    CHECK(roots[0] == doctest::Approx(1.));
+    CHECK(eq_solve(pol, line).size() == 2);
+  }
+
+  SUBCASE("closed forms agree with the Sturm solver")
+  {
+    Pol quartic{0.3, -2., 0.1, 1.2, -0.4};
+    Pol zero{0.};
+    Roots closed = eq_solve(quartic, zero);
+    Roots sturm  = solve_sturm(quartic.coeff(), -100., 100.);
+    REQUIRE(closed.size() == sturm.size());
+    for (std::size_t i{0}; i != closed.size(); ++i) {
+      CHECK(closed[i] == doctest::Approx(sturm[i]));
+    }
+  }
+}
+
+TEST_CASE("testing the float and long double engines")
+{
+  SUBCASE("tolerances follow the precision of the type")
+  {
+    static_assert(Globals::EPS_OF<double> == Globals::EPS);
+    static_assert(Globals::scaled_tolerance<double>(1e-15) == 1e-15);
+    CHECK(Globals::EPS_OF<float> == doctest::Approx(2.3e-4).epsilon(0.01));
+    CHECK(Globals::scaled_tolerance<float>(1e-15) > 1e-7f);
+    CHECK(Globals::EPS_OF<long double> <= Globals::EPS);
+  }
+
+  SUBCASE("closed forms and Sturm solver")
+  {
+    // (x - 1)(x - 2)(x - 3)
+    BasicRoots<float> const cubic{solve_cubic<float>(1., -6., 11., -6.)};
+    REQUIRE(cubic.size() == 3);
+    CHECK(cubic[0] == doctest::Approx(1.).epsilon(1e-5));
+    CHECK(cubic[1] == doctest::Approx(2.).epsilon(1e-5));
+    CHECK(cubic[2] == doctest::Approx(3.).epsilon(1e-5));
+
+    // (x^2 - 1)(x^2 - 4)
+    BasicRoots<long double> const quartic{
+        solve_quartic<long double>(1., 0., -5., 0., 4.)};
+    REQUIRE(quartic.size() == 4);
+    CHECK(std::abs(quartic[0] + 2.L) < 1e-15L);
+    CHECK(std::abs(quartic[3] - 2.L) < 1e-15L);
+
+    // the degree is lowered below Globals::EPS whatever the type: 1e-6 x^2
+    // is kept, with the root near -1e6 that the closed form loses in float
+    BasicRoots<float> const small{solve_quadratic<float>(1e-6f, 1., -1.)};
+    REQUIRE(small.size() == 2);
+    CHECK(small[0] == doctest::Approx(-1e6).epsilon(1e-5));
+    CHECK(small[1] == doctest::Approx(1.).epsilon(1e-5));
+    CHECK(solve_quadratic<float>(1e-9f, 1., -1.).size() == 1);
+
+    // x^6 - x = 0.5 - 0.5, solved in double and rounded to float
+    BasicPol<float> const pol{0.5f, -1.f, 0.f, 0.f, 0.f, 0.f, 1.f};
+    BasicRoots<float> const roots{
+        eq_solve(pol, BasicPol<float>{0.5f}, 0.5, 3.)};
+    REQUIRE(roots.size() == 1);
+    CHECK(roots[0] == 1.f);
+  }
+
+  SUBCASE("constexpr Vec2")
+  {
+    constexpr BasicVec2<float> a{1.f, 2.f};
+    static_assert(a.reflect({0.f, 1.f}) == BasicVec2<float>{1.f, -2.f});
+    static_assert(2. * a == BasicVec2<float>{2.f, 4.f});
+    BasicVec2<long double> b{3., 4.};
+    CHECK(b.normalize() == BasicVec2<long double>{0.6L, 0.8L});
+  }
+}
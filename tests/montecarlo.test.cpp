@@ -0,0 +1,237 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "montecarlo.hpp"
+#include "doctest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+TEST_CASE("testing the parallel montecarlo driver")
+{
+  Barrier barrier_up{4., 1.5, 0.7};
+  Barrier barrier_down{4., -1.5, -0.7};
+  Beam beam{0., 0.5, 0., 0.4};
+
+  std::size_t n{2 * CHUNK_SIZE + 123};
+
+  ThreadPool pool1{1};
+  auto res1 =
+      simulate_n_particles(barrier_up, barrier_down, beam, n, 42, pool1);
+
+  SUBCASE("every particle is generated")
+  {
+    CHECK(res1.n_generated == n);
+    CHECK(res1.y.size() == res1.theta.size());
+    CHECK(res1.y.size() > 0);
+    CHECK(static_cast<std::size_t>(res1.y.size()) <= n);
+  }
+
+  SUBCASE("results do not depend on the number of threads")
+  {
+    ThreadPool pool3{3};
+    auto res3 =
+        simulate_n_particles(barrier_up, barrier_down, beam, n, 42, pool3);
+
+    CHECK(res1.y.size() == res3.y.size());
+    auto s1 = res1.y.statistics();
+    auto s3 = res3.y.statistics();
+    CHECK(s1.mean == s3.mean);
+    CHECK(s1.std_dev == s3.std_dev);
+    CHECK(s1.skewness == s3.skewness);
+    CHECK(s1.kurtosis == s3.kurtosis);
+    CHECK(res1.theta.statistics().mean == res3.theta.statistics().mean);
+  }
+
+  SUBCASE("different seeds give different results")
+  {
+    auto res2 =
+        simulate_n_particles(barrier_up, barrier_down, beam, n, 43, pool1);
+    CHECK(res1.y.statistics().mean != res2.y.statistics().mean);
+  }
+
+  SUBCASE("exits are streamed in the same order for any number of threads")
+  {
+    std::vector<Exit> exits1;
+    std::vector<Exit> exits2;
+    ThreadPool pool2{2};
+    simulate_exits(barrier_up, barrier_down, beam, n, 42, pool1,
+                   [&](std::vector<Exit> const& e) {
+                     exits1.insert(exits1.end(), e.begin(), e.end());
+                   });
+    simulate_exits(barrier_up, barrier_down, beam, n, 42, pool2,
+                   [&](std::vector<Exit> const& e) {
+                     exits2.insert(exits2.end(), e.begin(), e.end());
+                   });
+
+    REQUIRE(exits1.size() == static_cast<std::size_t>(res1.y.size()));
+    REQUIRE(exits1.size() == exits2.size());
+    bool equal{true};
+    for (std::size_t i{0}; i != exits1.size(); ++i) {
+      equal = equal && exits1[i].y == exits2[i].y
+           && exits1[i].theta == exits2[i].theta;
+    }
+    CHECK(equal);
+  }
+}
+
+TEST_CASE("testing the quasi-random sampling")
+{
+  Barrier barrier_up{4., 1.5, 0.7};
+  Barrier barrier_down{4., -1.5, -0.7};
+  Beam beam{0., 0.5, 0., 0.4};
+  ThreadPool pool{2};
+
+  // the standard deviation of yf, compared with a large pseudo-random run
+  auto reference = simulate_n_particles(barrier_up, barrier_down, beam,
+                                        1 << 21, 1, pool);
+  double const ref_std{reference.y.statistics().std_dev};
+
+  std::size_t const n{1 << 14};
+  auto sobol = simulate_n_particles(barrier_up, barrier_down, beam, n, 1, pool,
+                                    Sampling::sobol);
+  auto pseudo = simulate_n_particles(barrier_up, barrier_down, beam, n, 1, pool);
+  CHECK(sobol.n_generated == n);
+  CHECK(sobol.y.statistics().std_dev != pseudo.y.statistics().std_dev);
+  CHECK(std::abs(sobol.y.statistics().std_dev - ref_std)
+        < std::abs(pseudo.y.statistics().std_dev - ref_std));
+
+  ThreadPool pool1{1};
+  auto sobol1 = simulate_n_particles(barrier_up, barrier_down, beam, n, 1,
+                                     pool1, Sampling::sobol);
+  CHECK(sobol1.y.statistics().mean == sobol.y.statistics().mean);
+
+  CHECK_THROWS_AS(simulate_n_particles(barrier_up, barrier_down, beam,
+                                       (std::size_t{1} << 32) + 1, 1, pool,
+                                       Sampling::sobol),
+                  std::invalid_argument);
+}
+
+TEST_CASE("testing the sequential stopping rule")
+{
+  Barrier barrier_up{4., 1.5, 0.7};
+  Barrier barrier_down{4., -1.5, -0.7};
+  Beam beam{0., 0.5, 0., 0.4};
+  ThreadPool pool{2};
+
+  StoppingRule rule;
+  rule.mean_error = 0.002;
+  rule.batch      = 2 * CHUNK_SIZE;
+  auto const run  = simulate_until(barrier_up, barrier_down, beam, rule, 5, pool);
+
+  CHECK(run.converged);
+  CHECK(run.seconds > 0.);
+  CHECK(run.result.y.mean_error() <= rule.mean_error);
+  CHECK(run.result.theta.mean_error() <= rule.mean_error);
+  CHECK(run.result.n_generated % (2 * CHUNK_SIZE) == 0);
+  // one batch less would not have been enough
+  CHECK(run.result.n_generated > 2 * CHUNK_SIZE);
+
+  auto const fixed = simulate_n_particles(barrier_up, barrier_down, beam,
+                                          run.result.n_generated, 5, pool);
+  CHECK(fixed.y.statistics().mean == run.result.y.statistics().mean);
+  CHECK(fixed.theta.statistics().std_dev
+        == run.result.theta.statistics().std_dev);
+
+  SUBCASE("the run stops at max_particles")
+  {
+    rule.std_dev_error = 1e-5;
+    rule.max_particles = 3 * CHUNK_SIZE + 10;
+    auto const capped =
+        simulate_until(barrier_up, barrier_down, beam, rule, 5, pool);
+    CHECK_FALSE(capped.converged);
+    CHECK(capped.result.n_generated == rule.max_particles);
+  }
+
+  SUBCASE("the default batch does not depend on the thread count")
+  {
+    rule.batch = 0;
+    ThreadPool pool3{3};
+    auto const run2 =
+        simulate_until(barrier_up, barrier_down, beam, rule, 5, pool);
+    auto const run3 =
+        simulate_until(barrier_up, barrier_down, beam, rule, 5, pool3);
+    CHECK(run2.result.n_generated % (DEFAULT_BATCH_CHUNKS * CHUNK_SIZE) == 0);
+    CHECK(run2.result.n_generated == run3.result.n_generated);
+    CHECK(run2.result.y.statistics().mean == run3.result.y.statistics().mean);
+  }
+
+  SUBCASE("a rule without targets throws")
+  {
+    CHECK_THROWS_AS(
+        simulate_until(barrier_up, barrier_down, beam, StoppingRule{}, 5, pool),
+        std::invalid_argument);
+  }
+}
+
+TEST_CASE("testing the parameter sweep")
+{
+  Beam beam{0., 0.5, 0., 0.4};
+  std::vector<Geometry> points{
+      {Barrier{4., 1.5, 0.7}, Barrier{4., -1.5, -0.7}},
+      {Barrier{3., 1.2, 0.9}, Barrier{3., -1.2, -0.9}},
+      {Barrier{Pol{1.5, 0., -0.05}, 4.}, Barrier{-Pol{1.5, 0., -0.05}, 4.}}};
+  std::size_t n{CHUNK_SIZE + 77};
+
+  ThreadPool pool3{3};
+  auto results = simulate_sweep(points, beam, n, 7, pool3);
+  REQUIRE(results.size() == points.size());
+
+  SUBCASE("every point gives the result of simulate_n_particles")
+  {
+    ThreadPool pool1{1};
+    for (std::size_t p{0}; p != points.size(); ++p) {
+      auto single = simulate_n_particles(points[p].barrier_up,
+                                         points[p].barrier_down, beam, n, 7,
+                                         pool1);
+      CHECK(results[p].n_generated == n);
+      CHECK(results[p].y.size() == single.y.size());
+      CHECK(results[p].y.statistics().mean == single.y.statistics().mean);
+      CHECK(results[p].y.statistics().kurtosis
+            == single.y.statistics().kurtosis);
+      CHECK(results[p].theta.statistics().std_dev
+            == single.theta.statistics().std_dev);
+    }
+  }
+
+  SUBCASE("common random numbers: equal points give equal results")
+  {
+    std::vector<Geometry> same{points[0], points[0]};
+    auto r = simulate_sweep(same, beam, n, 11, pool3);
+    CHECK(r[0].y.statistics().mean == r[1].y.statistics().mean);
+  }
+
+  CHECK(simulate_sweep({}, beam, n, 7, pool3).empty());
+}
+
+TEST_CASE("testing the thread pool")
+{
+  ThreadPool pool{2};
+  CHECK(pool.size() == 2);
+
+  std::vector<int> done(100, 0);
+  pool.parallel_for(done.size(), [&](std::size_t i) { ++done[i]; });
+  CHECK(std::count(done.begin(), done.end(), 1) == 100);
+
+  CHECK_THROWS(pool.parallel_for(10, [](std::size_t i) {
+    if (i == 5) {
+      throw std::runtime_error{"task failed"};
+    }
+  }));
+}
+
+TEST_CASE("testing the destruction of thread pools")
+{
+  // the workers are joined before the pool is destroyed, whether they are
+  // waiting or have just finished
+  for (int i{0}; i != 200; ++i) {
+    ThreadPool idle{3};
+  }
+  std::ptrdiff_t sum{0};
+  for (int i{0}; i != 200; ++i) {
+    ThreadPool pool{3};
+    std::vector<int> done(8, 0);
+    pool.parallel_for(done.size(), [&](std::size_t k) { done[k] = 1; });
+    sum += std::count(done.begin(), done.end(), 1);
+  }
+  CHECK(sum == 1600);
+}
@@ -0,0 +1,255 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "output.hpp"
+#include "doctest.h"
+#include <filesystem>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+std::string temp_path(std::string const& name)
+{
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+} // namespace
+
+TEST_CASE("testing the binary output")
+{
+  RunInfo info{1.5, 0.7, 4., {0.1, 0.5, -0.2, 0.4}, 1000, 42};
+
+  // two chunks, the second one larger than the buffer
+  std::vector<Exit> small{{0.25, -0.5}, {1. / 3., 0.1}, {-1.2, 2.}};
+  std::vector<Exit> large(BinaryWriter::BUFFER_SIZE / 8);
+  for (std::size_t i{0}; i != large.size(); ++i) {
+    large[i] = {static_cast<double>(i) * 1e-3, -static_cast<double>(i)};
+  }
+
+  SUBCASE("float64 values are read back exactly")
+  {
+    std::string const path{temp_path("biliardo_output_64.bin")};
+    {
+      BinaryWriter writer{path, info};
+      writer.write(small);
+      writer.write(std::vector<Exit>{});
+      writer.write(large);
+      writer.close();
+    }
+
+    BinaryReader reader{path};
+    CHECK(reader.info().r1 == info.r1);
+    CHECK(reader.info().r2 == info.r2);
+    CHECK(reader.info().l == info.l);
+    CHECK(reader.info().beam.mu_y == info.beam.mu_y);
+    CHECK(reader.info().beam.sigma_theta == info.beam.sigma_theta);
+    CHECK(reader.info().n_particles == info.n_particles);
+    CHECK(reader.info().seed == info.seed);
+    CHECK(reader.precision() == Precision::float64);
+
+    std::vector<Exit> exits;
+    REQUIRE(reader.read(exits));
+    REQUIRE(exits.size() == small.size());
+    CHECK(exits[1].y == small[1].y);
+    CHECK(exits[2].theta == small[2].theta);
+    REQUIRE(reader.read(exits));
+    CHECK(exits.empty());
+    REQUIRE(reader.read(exits));
+    REQUIRE(exits.size() == large.size());
+    CHECK(exits.back().y == large.back().y);
+    CHECK(exits.back().theta == large.back().theta);
+    CHECK_FALSE(reader.read(exits));
+
+    std::filesystem::remove(path);
+  }
+
+  SUBCASE("float32 values are rounded to float")
+  {
+    std::string const path{temp_path("biliardo_output_32.bin")};
+    {
+      // closed by the destructor
+      BinaryWriter writer{path, info, Precision::float32};
+      writer.write(small);
+    }
+    CHECK(std::filesystem::file_size(path) == 88 + 8 + 2 * 3 * 4);
+
+    BinaryReader reader{path};
+    CHECK(reader.precision() == Precision::float32);
+    std::vector<Exit> exits;
+    REQUIRE(reader.read(exits));
+    REQUIRE(exits.size() == small.size());
+    CHECK(exits[1].y == static_cast<float>(small[1].y));
+    CHECK(exits[1].y != small[1].y);
+    CHECK_FALSE(reader.read(exits));
+
+    std::filesystem::remove(path);
+  }
+
+  SUBCASE("invalid files")
+  {
+    std::string const path{temp_path("biliardo_output_bad.bin")};
+    {
+      std::ofstream file{path, std::ios::binary};
+      file << "not a binary output, just some text";
+    }
+    CHECK_THROWS_AS(BinaryReader{path}, std::runtime_error);
+
+    {
+      BinaryWriter writer{path, info};
+      writer.write(small);
+    }
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    BinaryReader reader{path};
+    std::vector<Exit> exits;
+    CHECK_THROWS_AS(reader.read(exits), std::runtime_error);
+
+    // a corrupt size is rejected before the chunk is allocated
+    {
+      BinaryWriter writer{path, info};
+    }
+    {
+      std::ofstream file{path, std::ios::binary | std::ios::app};
+      std::uint64_t const n{std::uint64_t{1} << 60};
+      file.write(reinterpret_cast<char const*>(&n), sizeof(n));
+      file << "some bytes";
+    }
+    BinaryReader corrupt{path};
+    CHECK_THROWS_AS(corrupt.read(exits), std::runtime_error);
+
+    std::filesystem::remove(path);
+    CHECK_THROWS_AS(BinaryReader{path}, std::runtime_error);
+  }
+}
+
+TEST_CASE("testing the csv output")
+{
+  std::string const path{temp_path("biliardo_output.csv")};
+  std::vector<Exit> exits{{0.25, -0.5},
+                          {1. / 3., 0.1},
+                          {-1.2e-300, 2.},
+                          {std::nextafter(1., 2.), -0.}};
+
+  auto read_lines = [&] {
+    std::ifstream file{path};
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);) {
+      lines.push_back(line);
+    }
+    return lines;
+  };
+
+  SUBCASE("shortest representation, read back exactly")
+  {
+    {
+      CsvWriter writer{path};
+      writer.write(exits);
+      writer.write(std::vector<Exit>{});
+      writer.close();
+    }
+    auto const lines = read_lines();
+    REQUIRE(lines.size() == exits.size());
+    CHECK(lines[0] == "0.25, -0.5");
+    CHECK(lines[1] == "0.3333333333333333, 0.1");
+    CHECK(lines[2] == "-1.2e-300, 2");
+    for (std::size_t i{0}; i != lines.size(); ++i) {
+      char* end{nullptr};
+      CHECK(std::strtod(lines[i].c_str(), &end) == exits[i].y);
+      CHECK(std::strtod(end + 1, nullptr) == exits[i].theta);
+    }
+  }
+
+  SUBCASE("precision and delimiter")
+  {
+    {
+      // closed by the destructor
+      CsvWriter writer{path, ";", 3};
+      writer.write(exits);
+    }
+    auto const lines = read_lines();
+    REQUIRE(lines.size() == exits.size());
+    CHECK(lines[1] == "0.333;0.1");
+    CHECK(lines[3] == "1;-0");
+  }
+
+  SUBCASE("more lines than the buffer")
+  {
+    std::vector<Exit> many(CsvWriter::BUFFER_SIZE / 16);
+    for (std::size_t i{0}; i != many.size(); ++i) {
+      many[i] = {static_cast<double>(i), 0.5};
+    }
+    {
+      CsvWriter writer{path};
+      writer.write(many);
+      writer.close();
+    }
+    auto const lines = read_lines();
+    REQUIRE(lines.size() == many.size());
+    CHECK(lines.back() == std::to_string(many.size() - 1) + ", 0.5");
+  }
+
+  SUBCASE("invalid arguments")
+  {
+    CHECK_THROWS_AS(CsvWriter(path, ", ", 18), std::invalid_argument);
+    CHECK_THROWS_AS(CsvWriter(path, ", ", -1), std::invalid_argument);
+    CHECK_THROWS_AS(CsvWriter(temp_path("no_such_dir/out.csv")),
+                    std::runtime_error);
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("testing the asynchronous writer")
+{
+  std::vector<std::vector<Exit>> written;
+  auto chunk = [](std::size_t i) {
+    return std::vector<Exit>(i % 3 + 1, Exit{static_cast<double>(i), 0.});
+  };
+
+  SUBCASE("chunks are written in order, a slow output blocks push")
+  {
+    AsyncWriter writer{[&](std::span<Exit const> exits) {
+                         std::this_thread::sleep_for(
+                             std::chrono::milliseconds{5});
+                         written.emplace_back(exits.begin(), exits.end());
+                       },
+                       2};
+    for (std::size_t i{0}; i != 10; ++i) {
+      writer.push(chunk(i));
+    }
+    writer.close();
+
+    REQUIRE(written.size() == 10);
+    for (std::size_t i{0}; i != 10; ++i) {
+      CHECK(written[i].size() == chunk(i).size());
+      CHECK(written[i][0].y == static_cast<double>(i));
+    }
+    WriterStats const stats{writer.stats()};
+    CHECK(stats.n_chunks == 10);
+    CHECK(stats.n_full > 0);
+    CHECK(stats.full_seconds > 0.);
+    CHECK(stats.max_queued <= 2);
+  }
+
+  SUBCASE("errors of the output are rethrown")
+  {
+    AsyncWriter writer{[&](std::span<Exit const>) {
+                         throw std::runtime_error{"disk full"};
+                       },
+                       1};
+    CHECK_THROWS_AS(
+        {
+          for (std::size_t i{0}; i != 3; ++i) {
+            writer.push(chunk(i));
+          }
+        },
+        std::runtime_error);
+    CHECK_THROWS_AS(writer.close(), std::runtime_error);
+  }
+
+  CHECK_THROWS_AS(AsyncWriter([](std::span<Exit const>) {}, 0),
+                  std::invalid_argument);
+}
@@ -0,0 +1,186 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "random.hpp"
+#include "doctest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("testing the Philox generator")
+{
+  SUBCASE("known answers of the reference implementation")
+  {
+    // with key = seed and counter = (counter, stream) split in 32-bit words
+    CHECK(Philox{0}(0, 0)
+          == Philox::Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+    CHECK(Philox{0xffffffffffffffff}(0xffffffffffffffff, 0xffffffffffffffff)
+          == Philox::Block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+    CHECK(Philox{0x299f31d0a4093822}(0x85a308d3243f6a88, 0x0370734413198a2e)
+          == Philox::Block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+  }
+
+  SUBCASE("seeds, counters and streams give different blocks")
+  {
+    Philox gen{42};
+    CHECK(gen(7) != gen(8));
+    CHECK(gen(7, 0) != gen(7, 1));
+    CHECK(gen(7) != Philox{43}(7));
+  }
+
+  SUBCASE("uniforms are in (0, 1)")
+  {
+    CHECK(to_unit({0, 0, 0, 0}) > 0.);
+    CHECK(to_unit({0xffffffff, 0xffffffff, 0, 0}) < 1.);
+
+    std::vector<double> u(100'000);
+    fill_uniform(Philox{1}, 0, 0, u);
+    double sum{0.};
+    for (double x : u) {
+      sum += x;
+    }
+    CHECK(sum / static_cast<double>(u.size()) == doctest::Approx(0.5).epsilon(0.01));
+
+    // the stream can be entered at any point
+    std::vector<double> tail(10);
+    fill_uniform(Philox{1}, 0, 500, tail);
+    CHECK(tail[3] == u[503]);
+  }
+}
+
+TEST_CASE("testing the scrambled Sobol sequence")
+{
+  Sobol const gen{3};
+  constexpr std::size_t n{1 << 10};
+  std::vector<double> u0(n);
+  std::vector<double> u1(n);
+  fill_sobol(gen, 0, u0, u1);
+
+  SUBCASE("the first 2^m points have one point per elementary interval")
+  {
+    // intervals 2^-k x 2^-(m - k), for every k
+    for (int k{0}; k <= 10; ++k) {
+      double const n0{static_cast<double>(1 << k)};
+      double const n1{static_cast<double>(n >> k)};
+      std::vector<int> count(n, 0);
+      for (std::size_t j{0}; j != n; ++j) {
+        auto const i0 = static_cast<std::size_t>(u0[j] * n0);
+        auto const i1 = static_cast<std::size_t>(u1[j] * n1);
+        ++count[i0 * (n >> k) + i1];
+      }
+      CHECK(std::all_of(count.begin(), count.end(),
+                        [](int c) { return c == 1; }));
+    }
+  }
+
+  SUBCASE("different seeds give different scramblings")
+  {
+    CHECK(Sobol{3}(5) == gen(5));
+    CHECK(Sobol{4}(5) != gen(5));
+    CHECK(gen(5) != gen(6));
+    CHECK(to_unit(std::uint32_t{0}) > 0.);
+    CHECK(to_unit(std::uint32_t{0xffffffff}) < 1.);
+  }
+
+  SUBCASE("the sequence can be entered at any point, up to 2^32")
+  {
+    std::vector<double> v0(3);
+    std::vector<double> v1(3);
+    fill_sobol(gen, 100, v0, v1);
+    CHECK(v0[2] == u0[102]);
+    CHECK(v1[2] == u1[102]);
+    CHECK_NOTHROW(fill_sobol(gen, (std::uint64_t{1} << 32) - 3, v0, v1));
+    CHECK_THROWS_AS(fill_sobol(gen, (std::uint64_t{1} << 32) - 2, v0, v1),
+                    std::invalid_argument);
+  }
+}
+
+TEST_CASE("testing the inverse normal cdf")
+{
+  CHECK(inverse_normal_cdf(0.5) == doctest::Approx(0.).epsilon(1e-15));
+  CHECK(inverse_normal_cdf(0.975) == doctest::Approx(1.959963984540054).epsilon(1e-14));
+  CHECK(inverse_normal_cdf(0.01) == doctest::Approx(-2.326347874040841).epsilon(1e-14));
+  CHECK(inverse_normal_cdf(1e-10) == doctest::Approx(-6.361340902404056).epsilon(1e-13));
+  CHECK(inverse_normal_cdf(0.) == -INFINITY);
+  CHECK(inverse_normal_cdf(1.) == INFINITY);
+
+  // inverse of 0.5 * erfc(-x / sqrt(2))
+  for (double x{-8.}; x < 4.; x += 0.37) {
+    double const p{0.5 * std::erfc(-x / std::sqrt(2.))};
+    CHECK(inverse_normal_cdf(p) == doctest::Approx(x).epsilon(1e-12));
+  }
+
+  // the vectorised span version gives the same values, in the central region
+  // and in the tails
+  std::vector<double> p(1000);
+  fill_uniform(Philox{3}, 0, 0, p);
+  p[0] = 1e-300;
+  p[1] = 0.075;
+  p[2] = 0.925;
+  std::vector<double> x{p};
+  inverse_normal_cdf(x);
+  for (std::size_t i{0}; i != p.size(); ++i) {
+    CHECK(x[i] == inverse_normal_cdf(p[i]));
+  }
+}
+
+TEST_CASE("testing the truncated normal distribution")
+{
+  SUBCASE("values are in the interval, with the right mean")
+  {
+    TruncatedNormal dist{0.3, 2., -1., 1.};
+    std::vector<double> y(100'000);
+    fill_truncated_normal(Philox{5}, 0, 0, dist, y);
+    double sum{0.};
+    int n_outside{0};
+    for (double x : y) {
+      n_outside += x < -1. || x > 1.;
+      sum += x;
+    }
+    CHECK(n_outside == 0);
+    // mean of N(0.3, 2) truncated to [-1, 1]
+    CHECK(std::abs(sum / static_cast<double>(y.size()) - 0.0242) < 0.01);
+  }
+
+  SUBCASE("intervals far in the tails, where rejection would never end")
+  {
+    TruncatedNormal right{0., 1., 9., 10.};
+    TruncatedNormal left{0., 1., -10., -9.};
+    for (double u{0.001}; u < 1.; u += 0.01) {
+      CHECK_UNARY(right(u) >= 9. && right(u) <= 10.);
+      CHECK(left(u) == -right(u));
+    }
+    // most of the probability is close to the lower bound
+    CHECK(right(0.5) == doctest::Approx(9.0758).epsilon(1e-5));
+
+    std::vector<double> u{0.001, 0.25, 0.5, 0.999};
+    std::vector<double> y{u};
+    right(y);
+    for (std::size_t i{0}; i != u.size(); ++i) {
+      CHECK(y[i] == right(u[i]));
+    }
+  }
+
+  SUBCASE("invalid parameters")
+  {
+    CHECK_THROWS_AS(TruncatedNormal(0., 0., -1., 1.), std::invalid_argument);
+    CHECK_THROWS_AS(TruncatedNormal(0., 1., 1., -1.), std::invalid_argument);
+    CHECK_THROWS_AS(TruncatedNormal(0., 1., 50., 51.), std::runtime_error);
+  }
+}
+
+TEST_CASE("testing the normal sampler")
+{
+  std::vector<double> x(200'000);
+  fill_normal(Philox{9}, 3, 0, 1., 2., x);
+  double s1{0.};
+  double s2{0.};
+  for (double v : x) {
+    s1 += v;
+    s2 += v * v;
+  }
+  double const n{static_cast<double>(x.size())};
+  double const mean{s1 / n};
+  CHECK(mean == doctest::Approx(1.).epsilon(0.02));
+  CHECK(std::sqrt(s2 / n - mean * mean) == doctest::Approx(2.).epsilon(0.02));
+}
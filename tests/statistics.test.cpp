@@ -1,6 +1,9 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "statistics.hpp"
 #include "doctest.h"
+#include <cmath>
+#include <random>
+#include <vector>
 
 // to add tests https://www.omnicalculator.com/statistics/skewness
 
@@ -53,4 +56,114 @@ TEST_CASE("Testing the class handling a floating point data sample")
     CHECK(result.skewness == doctest::Approx(2.2955));
     CHECK(result.kurtosis == doctest::Approx(5.5842));
   }
-}
\ No newline at end of file
+}
+TEST_CASE("Testing the standard errors")
+{
+  Sample sample;
+  CHECK(std::isinf(sample.mean_error()));
+  CHECK(std::isinf(sample.std_dev_error()));
+
+  for (double x : {1., 2., 3., 4.}) {
+    sample.add(x);
+  }
+  CHECK(sample.mean_error() == doctest::Approx(1.291 / 2.).epsilon(1e-3));
+  CHECK(sample.std_dev_error() == doctest::Approx(std::sqrt(0.05)));
+
+  // gaussian entries: sigma / sqrt(N) and sigma / sqrt(2 N)
+  std::default_random_engine eng{3};
+  std::normal_distribution dist{1., 2.};
+  Sample gauss;
+  for (int i{0}; i != 100'000; ++i) {
+    gauss.add(dist(eng));
+  }
+  CHECK(gauss.mean_error() == doctest::Approx(2. / std::sqrt(1e5)).epsilon(0.01));
+  CHECK(gauss.std_dev_error()
+        == doctest::Approx(2. / std::sqrt(2e5)).epsilon(0.03));
+}
+
+TEST_CASE("Testing the merge of two samples")
+{
+  Sample a;
+  Sample b;
+  Sample all;
+  for (double x : {14.5, 24.76, 345.}) {
+    a.add(x);
+    all.add(x);
+  }
+  for (double x : {1., 50.4, 67., 88.}) {
+    b.add(x);
+    all.add(x);
+  }
+  a.merge(b);
+  REQUIRE(a.size() == 7);
+
+  const auto merged = a.statistics();
+  const auto direct = all.statistics();
+  CHECK(merged.mean == doctest::Approx(direct.mean));
+  CHECK(merged.std_dev == doctest::Approx(direct.std_dev));
+  CHECK(merged.skewness == doctest::Approx(direct.skewness));
+  CHECK(merged.kurtosis == doctest::Approx(direct.kurtosis));
+}
+
+TEST_CASE("Testing the numerical stability of the moments")
+{
+  // a large offset does not change the central moments
+  Sample shifted;
+  for (double x : {14.5, 24.76, 345., 1., 50.4, 67., 88.}) {
+    shifted.add(1e9 + x);
+  }
+  const auto result = shifted.statistics();
+  CHECK(result.mean == doctest::Approx(1e9 + 84.38));
+  CHECK(result.std_dev == doctest::Approx(118.871));
+  CHECK(result.skewness == doctest::Approx(2.2955));
+  CHECK(result.kurtosis == doctest::Approx(5.5842));
+}
+
+TEST_CASE("Testing the batch add")
+{
+  std::vector<double> xs;
+  for (int i{0}; i != 5003; ++i) {
+    xs.push_back(1e6 + (i % 17) * 0.3 - (i % 5) * (i % 5) * 0.11);
+  }
+
+  Sample one_by_one;
+  for (double x : xs) {
+    one_by_one.add(x);
+  }
+  Sample batch;
+  batch.add(std::span<double const>{xs}.first(3));
+  batch.add(std::span<double const>{xs}.subspan(3));
+  REQUIRE(batch.size() == one_by_one.size());
+
+  const auto a = one_by_one.statistics();
+  const auto b = batch.statistics();
+  CHECK(b.mean == doctest::Approx(a.mean).epsilon(1e-14));
+  CHECK(b.std_dev == doctest::Approx(a.std_dev).epsilon(1e-10));
+  CHECK(b.skewness == doctest::Approx(a.skewness).epsilon(1e-8));
+  CHECK(b.kurtosis == doctest::Approx(a.kurtosis).epsilon(1e-8));
+}
+
+TEST_CASE("Testing samples with more than 2^31 entries")
+{
+  Sample sample;
+  for (double x : {1., 2., 3., 4.}) {
+    sample.add(x);
+  }
+  Sample empty;
+  sample.merge(empty);
+  empty.merge(sample);
+  CHECK(empty.size() == 4);
+
+  // merging a sample with a copy of itself doubles every count
+  for (int i{0}; i != 30; ++i) {
+    Sample const copy{sample};
+    sample.merge(copy);
+  }
+  CHECK(sample.size() == std::int64_t{4} << 30);
+
+  const auto result = sample.statistics();
+  CHECK(result.mean == doctest::Approx(2.5));
+  CHECK(result.std_dev == doctest::Approx(1.118034));
+  CHECK(result.skewness == doctest::Approx(0.0));
+  CHECK(result.kurtosis == doctest::Approx(-1.36));
+}
@@ -0,0 +1,92 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "unfolding.hpp"
+#include "doctest.h"
+#include <random>
+
+namespace {
+// compares the unfolding engine against the iterative reference on many
+// random trajectories
+void cross_check(Barrier const& up, Barrier const& down)
+{
+  auto unfolding = Unfolding::make(up, down);
+  REQUIRE(unfolding.has_value());
+
+  std::default_random_engine eng{7};
+  std::uniform_real_distribution y_dist{down.pol()(0.) * 0.99,
+                                        up.pol()(0.) * 0.99};
+  std::uniform_real_distribution theta_dist{-3.1, 3.1};
+
+  int n_mismatch{0};
+  for (int i{0}; i != 2000; ++i) {
+    Trajectory t{{0., y_dist(eng)}, theta_dist(eng)};
+    Result expected = simulate_single_particle(up, down, t);
+    Result res      = unfolding->simulate(t);
+    if (res.get_x() != doctest::Approx(expected.get_x())
+        || res.get_y() != doctest::Approx(expected.get_y()).epsilon(1e-6)
+        || res.get_theta()
+               != doctest::Approx(expected.get_theta()).epsilon(1e-6)) {
+      ++n_mismatch;
+    }
+  }
+  CHECK(n_mismatch == 0);
+}
+} // namespace
+
+TEST_CASE("testing the unfolding engine against simulate_single_particle")
+{
+  double l{4.};
+
+  SUBCASE("converging walls")
+  {
+    cross_check(Barrier{l, 1.5, 0.7}, Barrier{l, -1.5, -0.7});
+  }
+  SUBCASE("near-wedge with many bounces")
+  {
+    cross_check(Barrier{l, 1.5, 0.05}, Barrier{l, -1.5, -0.05});
+  }
+  SUBCASE("diverging walls")
+  {
+    cross_check(Barrier{l, 0.7, 1.5}, Barrier{l, -0.7, -1.5});
+  }
+  SUBCASE("parallel walls")
+  {
+    cross_check(Barrier{l, 1.5, 1.5}, Barrier{l, -1.5, -1.5});
+  }
+  SUBCASE("slanted parallel walls")
+  {
+    cross_check(Barrier{l, 1., 2.}, Barrier{l, -1., 0.});
+  }
+  SUBCASE("asymmetric walls")
+  {
+    cross_check(Barrier{l, 1.5, 1.}, Barrier{l, -0.5, -1.2});
+  }
+  SUBCASE("walls from a linear Pol")
+  {
+    Pol p{1.5, -0.2};
+    cross_check(Barrier{p, l}, Barrier{-p, l});
+  }
+}
+
+TEST_CASE("testing the unfolding engine on known trajectories")
+{
+  Pol barrier_pol{1.5, -0.2};
+  auto unfolding =
+      Unfolding::make(Barrier{barrier_pol, 4.}, Barrier{-barrier_pol, 4.});
+  REQUIRE(unfolding.has_value());
+
+  Result res = unfolding->simulate({{0., 0.}, 0.463647609});
+  CHECK(res.get_x() == doctest::Approx(4.));
+  CHECK(res.get_y() == doctest::Approx(0.0932203389752));
+  CHECK(res.get_theta() == doctest::Approx(1.2532298484));
+
+  CHECK(unfolding->simulate({{0., 0.}, -0.785398163}).get_x() == 0);
+}
+
+TEST_CASE("testing the unfolding engine is only built for linear channels")
+{
+  Pol quadratic{1.5, 0.1, -0.05};
+  CHECK_FALSE(Unfolding::make(Barrier{quadratic, 4.}, Barrier{-quadratic, 4.})
+                  .has_value());
+  CHECK_FALSE(
+      Unfolding::make(Barrier{4., -1., -1.}, Barrier{4., 1., 1.}).has_value());
+}